@@ -0,0 +1,72 @@
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/Imu.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <yaml-cpp/yaml.h>
+
+#include "lio_log.h"
+#include "pointcloud_preprocess.h"
+
+/// convert a ros bag into a native log, the scans are preprocessed with the given config so a replay skips both the
+/// ros deserialization and the preprocessing
+
+DEFINE_string(config_file, "./config/avia.yaml", "path to config file");
+DEFINE_string(bag_file, "", "path to the ros bag");
+DEFINE_string(log_dir, "", "dir of the output log");
+
+int main(int argc, char **argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::InitGoogleLogging(argv[0]);
+
+    auto yaml = YAML::LoadFile(FLAGS_config_file);
+    faster_lio::PointCloudPreprocess::Options preprocess_options;
+    if (!faster_lio::PointCloudPreprocess::LoadOptions(yaml, preprocess_options)) {
+        LOG(ERROR) << "failed to load " << FLAGS_config_file;
+        return -1;
+    }
+    faster_lio::PointCloudPreprocess preprocess(preprocess_options);
+
+    // only the topics of the config, a bag may hold other clouds
+    std::vector<std::string> topics;
+    try {
+        topics.emplace_back(yaml["common"]["lid_topic"].as<std::string>());
+        topics.emplace_back(yaml["common"]["imu_topic"].as<std::string>());
+    } catch (...) {
+        LOG(ERROR) << "bad conversion";
+        return -1;
+    }
+
+    faster_lio::LioLogWriter writer;
+    if (!writer.Open(FLAGS_log_dir)) {
+        return -1;
+    }
+
+    LOG(INFO) << "Opening rosbag, be patient";
+    rosbag::Bag bag(FLAGS_bag_file, rosbag::bagmode::Read);
+
+    PointCloudType::Ptr scan(new PointCloudType());
+    for (const rosbag::MessageInstance &m : rosbag::View(bag, rosbag::TopicQuery(topics))) {
+        auto point_cloud_msg = m.instantiate<sensor_msgs::PointCloud2>();
+        if (point_cloud_msg) {
+            preprocess.Process(point_cloud_msg, scan);
+            writer.AddScan(point_cloud_msg->header.stamp.toSec(), *scan);
+            continue;
+        }
+
+        auto imu_msg = m.instantiate<sensor_msgs::Imu>();
+        if (imu_msg) {
+            faster_lio::common::ImuData imu;
+            imu.timestamp_ = imu_msg->header.stamp.toSec();
+            imu.acc_ << imu_msg->linear_acceleration.x, imu_msg->linear_acceleration.y, imu_msg->linear_acceleration.z;
+            imu.gyro_ << imu_msg->angular_velocity.x, imu_msg->angular_velocity.y, imu_msg->angular_velocity.z;
+            writer.AddImu(imu);
+        }
+    }
+
+    return writer.Close() ? 0 : -1;
+}
@@ -0,0 +1,174 @@
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "lio_core.h"
+#include "lio_log.h"
+#include "utils.h"
+
+/// run faster-LIO on many native logs concurrently, every run has its own core, timer and outputs
+
+DEFINE_string(job_file, "", "one run per line: name config_file log_dir, # for comments");
+DEFINE_string(output_dir, "./Log/batch", "dir of the per-run trajectories, time logs and the summary");
+DEFINE_int32(num_jobs, 0, "runs in parallel, 0 for cores / threads_per_job");
+DEFINE_int32(threads_per_job, 1, "threads of the parallel stages of every run, 0 to keep the config");
+
+namespace {
+
+std::atomic<bool> flag_exit{false};  // set on ctrl-c, stops all runs
+
+struct Job {
+    std::string name_;
+    std::string config_file_;
+    std::string log_dir_;
+};
+
+struct JobResult {
+    bool ok_ = false;
+    size_t num_scans_ = 0;   // replayed scans
+    size_t num_frames_ = 0;  // processed frames
+    double mean_time_ms_ = 0;
+    double wall_time_s_ = 0;
+};
+
+std::vector<Job> LoadJobs(const std::string &job_file) {
+    std::vector<Job> jobs;
+    std::ifstream fin(job_file);
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream iss(line);
+        Job job;
+        if (!(iss >> job.name_) || job.name_[0] == '#') {
+            continue;
+        }
+        if (!(iss >> job.config_file_ >> job.log_dir_)) {
+            LOG(WARNING) << "skip bad job line: " << line;
+            continue;
+        }
+        jobs.emplace_back(job);
+    }
+    return jobs;
+}
+
+JobResult RunJob(const Job &job) {
+    JobResult result;
+    auto t1 = std::chrono::steady_clock::now();
+
+    faster_lio::LioCore::Options options;
+    try {
+        // runs on a worker thread, an exception would take all other runs down with it
+        if (!faster_lio::LioCore::LoadOptions(YAML::LoadFile(job.config_file_), options)) {
+            LOG(ERROR) << job.name_ << ": failed to load " << job.config_file_;
+            return result;
+        }
+    } catch (const YAML::Exception &e) {
+        LOG(ERROR) << job.name_ << ": cannot read " << job.config_file_ << ": " << e.what();
+        return result;
+    }
+    if (FLAGS_threads_per_job > 0) {
+        // the runs share the machine, pinning every run to the cores of its config would stack them up
+        options.arena_options_.num_threads_ = FLAGS_threads_per_job;
+        options.arena_options_.cpu_ids_.clear();
+    }
+
+    auto core = std::make_shared<faster_lio::LioCore>();
+    faster_lio::LioLogReader log;
+    if (!core->Init(options) || !log.Open(job.log_dir_)) {
+        LOG(ERROR) << job.name_ << ": init failed";
+        return result;
+    }
+
+    const std::string prefix = FLAGS_output_dir + "/" + job.name_;
+    core->GetTracer().SetThreadName(job.name_);
+    std::ofstream traj(prefix + "_traj.txt");
+    traj << "#timestamp x y z q_x q_y q_z q_w" << std::endl;
+    result.num_scans_ = log.Replay(*core, [&](bool processed) {
+        if (processed) {
+            core->WriteTumPose(traj);
+            result.num_frames_++;
+        }
+        return !flag_exit;
+    });
+
+    const auto &timer = core->GetTimer();
+    timer.DumpIntoFile(prefix + "_time.log");
+    if (core->GetTracer().Enabled()) {
+        core->GetTracer().Dump(prefix + "_trace.json");
+    }
+    result.mean_time_ms_ = timer.GetMeanTime("Laser Mapping Single Run");
+    result.wall_time_s_ =
+        std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - t1).count();
+    result.ok_ = true;
+    LOG(INFO) << job.name_ << ": " << result.num_frames_ << " frames in " << result.wall_time_s_ << " s";
+    return result;
+}
+
+}  // namespace
+
+void SigHandle(int sig) {
+    flag_exit = true;
+    LOG(WARNING) << "catch sig " << sig;
+}
+
+int main(int argc, char **argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::InitGoogleLogging(argv[0]);
+
+    const auto jobs = LoadJobs(FLAGS_job_file);
+    if (jobs.empty()) {
+        LOG(ERROR) << "no job in " << FLAGS_job_file;
+        return -1;
+    }
+    std::filesystem::create_directories(FLAGS_output_dir);
+
+    int num_workers = FLAGS_num_jobs;
+    if (num_workers <= 0) {
+        num_workers = std::max(1u, std::thread::hardware_concurrency()) / std::max(1, FLAGS_threads_per_job);
+    }
+    num_workers = std::clamp<int>(num_workers, 1, jobs.size());
+    LOG(INFO) << jobs.size() << " jobs, " << num_workers << " in parallel";
+
+    /// handle ctrl-c
+    signal(SIGINT, SigHandle);
+
+    // every worker takes the next job until none is left
+    std::vector<JobResult> results(jobs.size());
+    std::atomic<size_t> next_job{0};
+    std::vector<std::thread> workers;
+    for (int w = 0; w < num_workers; ++w) {
+        workers.emplace_back([&]() {
+            for (size_t i = next_job++; i < jobs.size() && !flag_exit; i = next_job++) {
+                results[i] = RunJob(jobs[i]);
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    const std::string summary_file = FLAGS_output_dir + "/summary.csv";
+    std::ofstream summary(summary_file);
+    summary << "name,status,scans,frames,mean_time_ms,fps,wall_time_s" << std::endl;
+    int num_failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto &r = results[i];
+        num_failed += r.ok_ ? 0 : 1;
+        summary << jobs[i].name_ << "," << (r.ok_ ? "ok" : "failed") << "," << r.num_scans_ << "," << r.num_frames_
+                << "," << r.mean_time_ms_ << "," << (r.mean_time_ms_ > 0 ? 1000.0 / r.mean_time_ms_ : 0.0) << ","
+                << r.wall_time_s_ << std::endl;
+    }
+    LOG(INFO) << "summary saved to: " << summary_file << ", failed runs: " << num_failed;
+
+    return num_failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,108 @@
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <yaml-cpp/yaml.h>
+#include <atomic>
+#include <csignal>
+#include <fstream>
+
+#include "lio_core.h"
+#include "lio_log.h"
+#include "metrics.h"
+#include "utils.h"
+
+/// run faster-LIO without ros, from a native log written by bag_to_lio_log
+
+DEFINE_string(config_file, "./config/avia.yaml", "path to config file");
+DEFINE_string(log_dir, "", "dir of the native log");
+DEFINE_string(time_log_file, "./Log/time.log", "path to time log file");
+DEFINE_string(traj_log_file, "./Log/traj.txt", "path to traj log file");
+DEFINE_bool(watch_config, true, "apply edits of the runtime parameters in config_file while running");
+DEFINE_int32(metrics_port, 0, "local http port of the live metrics, 0 for off");
+DEFINE_string(trace_file, "./Log/trace.json", "timeline dump, written at exit and on SIGUSR1 if trace/buffer_size > 0");
+
+namespace {
+std::atomic<bool> flag_exit{false};        // set on ctrl-c
+std::atomic<bool> flag_dump_trace{false};  // set on SIGUSR1
+}  // namespace
+
+void SigHandle(int sig) {
+    flag_exit = true;
+    LOG(WARNING) << "catch sig " << sig;
+}
+
+void SigDumpTrace(int sig) { flag_dump_trace = true; }
+
+int main(int argc, char **argv) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::InitGoogleLogging(argv[0]);
+
+    faster_lio::LioCore::Options options;
+    if (!faster_lio::LioCore::LoadOptions(YAML::LoadFile(FLAGS_config_file), options)) {
+        LOG(ERROR) << "failed to load " << FLAGS_config_file;
+        return -1;
+    }
+
+    auto core = std::make_shared<faster_lio::LioCore>();
+    if (!core->Init(options)) {
+        LOG(ERROR) << "lio core init failed.";
+        return -1;
+    }
+
+    faster_lio::LioLogReader log;
+    if (!log.Open(FLAGS_log_dir)) {
+        return -1;
+    }
+    LOG(INFO) << "imu samples: " << log.NumImu() << ", scans: " << log.NumScans();
+
+    faster_lio::MetricsServer metrics_server(core->GetMetrics());
+    if (FLAGS_metrics_port > 0) {
+        metrics_server.Start(FLAGS_metrics_port);
+    }
+
+    /// handle ctrl-c, kill -USR1 dumps the timeline so far
+    signal(SIGINT, SigHandle);
+    signal(SIGUSR1, SigDumpTrace);
+    auto &tracer = core->GetTracer();
+    tracer.SetThreadName("replay");
+
+    std::ofstream traj(FLAGS_traj_log_file);
+    traj << "#timestamp x y z q_x q_y q_z q_w" << std::endl;
+
+    faster_lio::FileWatcher config_watcher(FLAGS_config_file);
+    log.Replay(*core, [&](bool processed) {
+        if (processed) {
+            core->WriteTumPose(traj);
+        }
+        if (flag_dump_trace.exchange(false) && tracer.Enabled()) {
+            tracer.Dump(FLAGS_trace_file);
+        }
+        if (FLAGS_watch_config && config_watcher.Changed()) {
+            faster_lio::LioCore::Options new_options;
+            try {
+                if (faster_lio::LioCore::LoadOptions(YAML::LoadFile(FLAGS_config_file), new_options)) {
+                    core->UpdateOptions(new_options);
+                }
+            } catch (const YAML::Exception &e) {
+                LOG(ERROR) << "cannot parse " << FLAGS_config_file << ": " << e.what();
+            }
+        }
+        return !flag_exit;
+    });
+
+    /// print the fps
+    const auto &timer = core->GetTimer();
+    double fps = 1.0 / (timer.GetMeanTime("Laser Mapping Single Run") / 1000.);
+    LOG(INFO) << "Faster LIO average FPS: " << fps;
+    LOG(INFO) << "trajectory saved to: " << FLAGS_traj_log_file;
+
+    timer.PrintAll();
+    timer.DumpIntoFile(FLAGS_time_log_file);
+    if (tracer.Enabled()) {
+        tracer.Dump(FLAGS_trace_file);
+    }
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 //
 #include <gflags/gflags.h>
 #include <unistd.h>
+#include <atomic>
 #include <csignal>
 
 #include "laser_mapping.h"
@@ -12,8 +13,12 @@
 /// run the lidar mapping in online mode
 
 // DEFINE_string(traj_log_file, "./Log/traj.txt", "path to traj log file");
+namespace {
+std::atomic<bool> flag_exit{false};  // set on ctrl-c
+}  // namespace
+
 void SigHandle(int sig) {
-    faster_lio::options::FLAG_EXIT = true;
+    flag_exit = true;
     ROS_WARN("catch sig %d", sig);
 }
 
@@ -29,6 +34,7 @@ int main(int argc, char **argv) {
 
     auto laser_mapping = std::make_shared<faster_lio::LaserMapping>();
     laser_mapping->InitROS(nh, pnh);
+    laser_mapping->Core()->GetTracer().SetThreadName("spin and mapping");
 
     signal(SIGINT, SigHandle);
     ros::Rate rate(100);
@@ -37,7 +43,7 @@ int main(int argc, char **argv) {
 
     // online, almost same with offline, just receive the messages from ros
     while (ros::ok()) {
-        if (faster_lio::options::FLAG_EXIT) {
+        if (flag_exit) {
             break;
         }
         ros::spinOnce();
@@ -48,7 +54,7 @@ int main(int argc, char **argv) {
     LOG(INFO) << "finishing mapping";
     laser_mapping->Finish();
 
-    // faster_lio::Timer::PrintAll();
+    laser_mapping->Core()->GetTimer().PrintAll();
     // LOG(INFO) << "save trajectory to: " << FLAGS_traj_log_file;
     // laser_mapping->Savetrajectory(FLAGS_traj_log_file);
 
@@ -0,0 +1,90 @@
+#ifndef FASTER_LIO_BENCH_DATA_H
+#define FASTER_LIO_BENCH_DATA_H
+
+#include <pcl/io/pcd_io.h>
+#include <cstdlib>
+#include <random>
+
+#include "common_lib.h"
+
+namespace faster_lio::bench {
+
+/**
+ * synthetic indoor-like scene: floor, ceiling and four walls of a box, with some noise
+ * if FASTER_LIO_BENCH_PCD points to a pcd file, the recorded points are used instead
+ * @param num  number of points
+ * @param seed random seed
+ */
+inline PointVector MapPoints(int num, unsigned int seed = 42) {
+    const char *pcd = std::getenv("FASTER_LIO_BENCH_PCD");
+    if (pcd != nullptr) {
+        PointCloudType cloud;
+        if (pcl::io::loadPCDFile(pcd, cloud) == 0 && !cloud.empty()) {
+            PointVector points;
+            points.reserve(num);
+            for (int i = 0; i < num; ++i) {
+                points.emplace_back(cloud.points[i % cloud.size()]);
+            }
+            return points;
+        }
+    }
+
+    constexpr float half_size = 20.0, height = 5.0, noise = 0.02;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(-half_size, half_size), h(0, height);
+    std::normal_distribution<float> n(0, noise);
+
+    PointVector points(num);
+    for (int i = 0; i < num; ++i) {
+        PointType &pt = points[i];
+        switch (i % 6) {
+            case 0:  // floor
+                pt.getVector3fMap() << u(rng), u(rng), n(rng);
+                break;
+            case 1:  // ceiling
+                pt.getVector3fMap() << u(rng), u(rng), height + n(rng);
+                break;
+            case 2:
+                pt.getVector3fMap() << half_size + n(rng), u(rng), h(rng);
+                break;
+            case 3:
+                pt.getVector3fMap() << -half_size + n(rng), u(rng), h(rng);
+                break;
+            case 4:
+                pt.getVector3fMap() << u(rng), half_size + n(rng), h(rng);
+                break;
+            default:
+                pt.getVector3fMap() << u(rng), -half_size + n(rng), h(rng);
+                break;
+        }
+        pt.intensity = 1.0;
+    }
+    return points;
+}
+
+/// a scan of the same scene seen from (0, 0, 1.5), in the lidar frame
+inline PointVector ScanPoints(int num, unsigned int seed = 7) {
+    PointVector points = MapPoints(num, seed);
+    for (auto &pt : points) {
+        pt.z -= 1.5;
+    }
+    return points;
+}
+
+/// the 5 nearest-neighbour-like points of a noisy plane
+inline PointVector PlanePatch(unsigned int seed = 3) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> u(-0.5, 0.5);
+    std::normal_distribution<float> n(0, 0.01);
+
+    PointVector points(options::NUM_MATCH_POINTS);
+    for (auto &pt : points) {
+        const float x = u(rng), y = u(rng);
+        pt.getVector3fMap() << 10 + x, 3 + y, 0.2 * x - 0.1 * y + 1 + n(rng);
+    }
+    return points;
+}
+
+}  // namespace faster_lio::bench
+
+#endif  // FASTER_LIO_BENCH_DATA_H
@@ -0,0 +1,60 @@
+#include <benchmark/benchmark.h>
+
+#include "use-ikfom.hpp"
+
+namespace faster_lio::bench {
+
+using KFType = esekfom::esekf<state_ikfom, 12, input_ikfom>;
+
+/// iterated update with a synthetic observation, arg: number of features
+void BM_IEKFUpdate(benchmark::State &state) {
+    const int num = state.range(0);
+    const Eigen::Matrix<double, 12, Eigen::Dynamic> h_x_T = Eigen::Matrix<double, 12, Eigen::Dynamic>::Random(12, num);
+    const Eigen::VectorXd h = Eigen::VectorXd::Random(num) * 0.01;
+
+    std::vector<double> epsi(23, 0.001);
+    KFType kf;
+    kf.init_dyn_runtime_share(get_f, df_dx, df_dw, 4, epsi.data());
+    const state_ikfom x0 = kf.get_x();
+    const KFType::cov P0 = kf.get_P();
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        state_ikfom x = x0;
+        KFType::cov P = P0;
+        kf.change_x(x);
+        kf.change_P(P);
+        state.ResumeTiming();
+
+        double solve_time = 0;
+        kf.update_iterated_dyn_share_modified(
+            0.001, solve_time, [&](state_ikfom &, esekfom::dyn_share_datastruct<double> &ekfom_data) {
+                ekfom_data.h_x_T = h_x_T;
+                ekfom_data.h = h;
+            });
+        benchmark::DoNotOptimize(kf.get_x());
+    }
+    state.SetItemsProcessed(state.iterations() * num);
+}
+
+/// imu propagation of one sample
+void BM_IEKFPredict(benchmark::State &state) {
+    KFType kf;
+    std::vector<double> epsi(23, 0.001);
+    kf.init_dyn_runtime_share(get_f, df_dx, df_dw, 4, epsi.data());
+
+    Eigen::Matrix<double, 12, 12> Q = process_noise_cov();
+    input_ikfom in;
+    in.acc << 0.1, 0.2, 9.8;
+    in.gyro << 0.01, -0.02, 0.1;
+    double dt = 0.005;
+    for (auto _ : state) {
+        kf.predict_modified(dt, Q, in);
+        benchmark::DoNotOptimize(kf.get_P());
+    }
+}
+
+BENCHMARK(BM_IEKFUpdate)->Arg(10)->Arg(100)->Arg(1000)->Arg(5000)->Arg(20000);
+BENCHMARK(BM_IEKFPredict);
+
+}  // namespace faster_lio::bench
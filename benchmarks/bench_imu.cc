@@ -0,0 +1,64 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_data.h"
+#include "imu_processing.hpp"
+
+namespace faster_lio::bench {
+
+constexpr double kImuRate = 200.0;
+constexpr double kScanTime = 0.1;
+
+/// imu samples of a slow turn in [begin, end)
+void FillImu(double begin, double end, std::deque<common::ImuData> &imu) {
+    imu.clear();
+    for (double t = begin; t < end; t += 1.0 / kImuRate) {
+        common::ImuData sample;
+        sample.timestamp_ = t;
+        sample.acc_ << 0.1, 0, common::G_m_s2;
+        sample.gyro_ << 0, 0, 0.2;
+        imu.push_back(sample);
+    }
+}
+
+/// undistort one scan with imu propagation, arg: number of points
+void BM_UndistortPcl(benchmark::State &state) {
+    const PointVector scan = ScanPoints(state.range(0));
+    esekfom::esekf<state_ikfom, 12, input_ikfom> kf;
+    std::vector<double> epsi(23, 0.001);
+    kf.init_dyn_runtime_share(get_f, df_dx, df_dw, 4, epsi.data());
+
+    Timer timer;
+    ImuProcess imu(ImuProcess::Options(), timer);
+    common::MeasureGroup meas;
+    PointCloudType::Ptr undistorted(new PointCloudType());
+
+    // stationary samples to get through the imu initialization
+    double t = 1.0;
+    FillImu(t, t + (MAX_INI_COUNT + 5) / kImuRate, meas.imu_);
+    meas.lidar_bag_time_ = t;
+    meas.lidar_end_time_ = t + kScanTime;
+    imu.Process(meas, kf, undistorted);
+    t = meas.imu_.back().timestamp_;
+
+    meas.lidar_->points.assign(scan.begin(), scan.end());
+    for (size_t i = 0; i < scan.size(); ++i) {
+        meas.lidar_->points[i].curvature = kScanTime * 1000.0 * i / scan.size();  // offset time in ms
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        meas.lidar_bag_time_ = t;
+        meas.lidar_end_time_ = t + kScanTime;
+        FillImu(t + 1.0 / kImuRate, t + kScanTime + 1.0 / kImuRate, meas.imu_);
+        t = meas.lidar_end_time_;
+        state.ResumeTiming();
+
+        imu.Process(meas, kf, undistorted);
+        benchmark::DoNotOptimize(undistorted->points.data());
+    }
+    state.SetItemsProcessed(state.iterations() * scan.size());
+}
+
+BENCHMARK(BM_UndistortPcl)->Arg(5000)->Arg(20000)->Unit(benchmark::kMicrosecond);
+
+}  // namespace faster_lio::bench
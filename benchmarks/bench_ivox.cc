@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_data.h"
+#include "ivox3d/ivox3d.h"
+
+namespace faster_lio::bench {
+
+template <IVoxNodeType node_type, typename StoreType = PointType>
+using BenchIVox = IVox<3, node_type, PointType, StoreType>;
+
+template <IVoxNodeType node_type>
+typename BenchIVox<node_type>::Options IVoxOptions(int nearby) {
+    typename BenchIVox<node_type>::Options options;
+    options.resolution_ = 0.5;
+    switch (nearby) {
+        case 0:
+            options.nearby_type_ = BenchIVox<node_type>::NearbyType::CENTER;
+            break;
+        case 6:
+            options.nearby_type_ = BenchIVox<node_type>::NearbyType::NEARBY6;
+            break;
+        case 18:
+            options.nearby_type_ = BenchIVox<node_type>::NearbyType::NEARBY18;
+            break;
+        default:
+            options.nearby_type_ = BenchIVox<node_type>::NearbyType::NEARBY26;
+            break;
+    }
+    return options;
+}
+
+/// insert a whole map, arg: number of points
+template <IVoxNodeType node_type, typename StoreType = PointType>
+void BM_IVoxAddPoints(benchmark::State &state) {
+    const PointVector points = MapPoints(state.range(0));
+    for (auto _ : state) {
+        BenchIVox<node_type, StoreType> ivox(IVoxOptions<node_type>(18));
+        ivox.AddPoints(points);
+        benchmark::DoNotOptimize(ivox.NumValidGrids());
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+}
+
+/// knn of a scan against a map, arg: nearby type (0, 6, 18, 26)
+template <IVoxNodeType node_type, typename StoreType = PointType>
+void BM_IVoxGetClosestPoint(benchmark::State &state) {
+    BenchIVox<node_type, StoreType> ivox(IVoxOptions<node_type>(state.range(0)));
+    ivox.AddPoints(MapPoints(200000));
+    PointVector scan = MapPoints(5000, 7);
+
+    PointType closest[options::NUM_MATCH_POINTS];
+    for (auto _ : state) {
+        for (const auto &pt : scan) {
+            benchmark::DoNotOptimize(ivox.GetClosestPoint(pt, closest, options::NUM_MATCH_POINTS));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * scan.size());
+}
+
+BENCHMARK_TEMPLATE(BM_IVoxAddPoints, IVoxNodeType::DEFAULT)->Arg(10000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_IVoxAddPoints, IVoxNodeType::DEFAULT, MapPointXYZ)->Arg(10000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_IVoxAddPoints, IVoxNodeType::QUANTIZED)->Arg(10000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_IVoxAddPoints, IVoxNodeType::PHC)->Arg(10000)->Arg(100000);
+BENCHMARK_TEMPLATE(BM_IVoxGetClosestPoint, IVoxNodeType::DEFAULT)->Arg(0)->Arg(6)->Arg(18)->Arg(26);
+BENCHMARK_TEMPLATE(BM_IVoxGetClosestPoint, IVoxNodeType::DEFAULT, MapPointXYZ)->Arg(0)->Arg(6)->Arg(18)->Arg(26);
+BENCHMARK_TEMPLATE(BM_IVoxGetClosestPoint, IVoxNodeType::QUANTIZED)->Arg(0)->Arg(6)->Arg(18)->Arg(26);
+BENCHMARK_TEMPLATE(BM_IVoxGetClosestPoint, IVoxNodeType::PHC)->Arg(0)->Arg(6)->Arg(18)->Arg(26);
+
+}  // namespace faster_lio::bench
@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_data.h"
+#include "lio_core.h"
+
+namespace faster_lio::bench {
+
+/// the estimation core with the velodyne config
+std::shared_ptr<LioCore> MakeLioCore() {
+    LioCore::Options options;
+    if (!LioCore::LoadOptions(YAML::LoadFile(std::string(FASTER_LIO_CONFIG_DIR) + "velodyne.yaml"), options)) {
+        return nullptr;
+    }
+
+    auto core = std::make_shared<LioCore>();
+    if (!core->Init(options)) {
+        return nullptr;
+    }
+    return core;
+}
+
+/// one observation model call, arg 0: number of scan points, arg 1: search the correspondences or not
+void BM_ObsModel(benchmark::State &state) {
+    auto core = MakeLioCore();
+    if (core == nullptr) {
+        state.SkipWithError("failed to init the lio core");
+        return;
+    }
+
+    const int num = state.range(0);
+    core->SetMapAndScan(MapPoints(200000), ScanPoints(num));
+
+    state_ikfom s;
+    s.pos(2) = 1.5;
+    esekfom::dyn_share_datastruct<double> ekfom_data;
+    ekfom_data.converge = true;
+    core->ObsModel(s, ekfom_data);  // the first call always searches
+
+    for (auto _ : state) {
+        ekfom_data.converge = state.range(1) != 0;
+        core->ObsModel(s, ekfom_data);
+        benchmark::DoNotOptimize(ekfom_data.h.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num);
+}
+
+BENCHMARK(BM_ObsModel)
+    ->Args({1000, 1})
+    ->Args({5000, 1})
+    ->Args({20000, 1})
+    ->Args({1000, 0})
+    ->Args({5000, 0})
+    ->Args({20000, 0})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace faster_lio::bench
@@ -0,0 +1,21 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_data.h"
+
+namespace faster_lio::bench {
+
+/// plane fit of the matched neighbours, arg: number of neighbours
+void BM_EstiPlane(benchmark::State &state) {
+    PointVector points = PlanePatch();
+    const int num = state.range(0);
+
+    common::V4F plane;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(common::esti_plane(plane, points.data(), num, 0.1f));
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_EstiPlane)->Arg(options::MIN_NUM_MATCH_POINTS)->Arg(options::NUM_MATCH_POINTS);
+
+}  // namespace faster_lio::bench
@@ -0,0 +1,70 @@
+#include <benchmark/benchmark.h>
+
+#include "bench_data.h"
+#include "pointcloud_preprocess.h"
+
+namespace faster_lio::bench {
+
+constexpr int kNumRings = 32;
+
+/// a velodyne-like message with per-point offset time
+sensor_msgs::PointCloud2::ConstPtr VelodyneMsg(int num) {
+    const PointVector scan = ScanPoints(num);
+    pcl::PointCloud<velodyne_ros::Point> cloud;
+    cloud.resize(num);
+    for (int i = 0; i < num; ++i) {
+        auto &pt = cloud.points[i];
+        pt.getVector3fMap() = scan[i].getVector3fMap();
+        pt.intensity = scan[i].intensity;
+        pt.ring = i % kNumRings;
+        pt.time = 0.1f * i / num;
+    }
+
+    sensor_msgs::PointCloud2::Ptr msg(new sensor_msgs::PointCloud2());
+    pcl::toROSMsg(cloud, *msg);
+    return msg;
+}
+
+/// an ouster-like message with per-point offset time in ns
+sensor_msgs::PointCloud2::ConstPtr OusterMsg(int num) {
+    const PointVector scan = ScanPoints(num);
+    pcl::PointCloud<ouster_ros::Point> cloud;
+    cloud.resize(num);
+    for (int i = 0; i < num; ++i) {
+        auto &pt = cloud.points[i];
+        pt.getVector3fMap() = scan[i].getVector3fMap();
+        pt.intensity = scan[i].intensity;
+        pt.ring = i % kNumRings;
+        pt.t = static_cast<uint32_t>(1e8 * i / num);
+        pt.range = static_cast<uint32_t>(scan[i].getVector3fMap().norm() * 1000);
+    }
+
+    sensor_msgs::PointCloud2::Ptr msg(new sensor_msgs::PointCloud2());
+    pcl::toROSMsg(cloud, *msg);
+    return msg;
+}
+
+/// preprocess one message, arg: number of points
+template <LidarType lidar_type>
+void BM_Preprocess(benchmark::State &state) {
+    const int num = state.range(0);
+    auto msg = lidar_type == LidarType::VELO32 ? VelodyneMsg(num) : OusterMsg(num);
+
+    PointCloudPreprocess::Options options;
+    options.lidar_type_ = lidar_type;
+    options.blind_ = 0.5;
+    options.point_filter_num_ = 2;
+    options.num_scans_ = kNumRings;
+    PointCloudPreprocess preprocess(options);
+    PointCloudType::Ptr out(new PointCloudType());
+    for (auto _ : state) {
+        preprocess.Process(msg, out);
+        benchmark::DoNotOptimize(out->points.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num);
+}
+
+BENCHMARK_TEMPLATE(BM_Preprocess, LidarType::VELO32)->Arg(30000)->Arg(120000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_Preprocess, LidarType::OUST64)->Arg(65536)->Arg(131072)->Unit(benchmark::kMicrosecond);
+
+}  // namespace faster_lio::bench
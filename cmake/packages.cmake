@@ -21,6 +21,7 @@ find_package(catkin REQUIRED COMPONENTS
         sensor_msgs
         roscpp
         rospy
+        rosbag
         std_msgs
         pcl_ros
         tf
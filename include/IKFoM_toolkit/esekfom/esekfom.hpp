@@ -35,7 +35,9 @@
 #ifndef ESEKFOM_EKF_HPP
 #define ESEKFOM_EKF_HPP
 
+#include <algorithm>
 #include <cstdlib>
+#include <type_traits>
 #include <vector>
 
 #include <Eigen/Core>
@@ -80,8 +82,12 @@ struct dyn_share_datastruct {
     bool converge;
     Eigen::Matrix<T, Eigen::Dynamic, 1> z;
     Eigen::Matrix<T, Eigen::Dynamic, 1> h;
+    Eigen::Matrix<T, Eigen::Dynamic, 1> weight;  // diagonal weights R / R_i per measurement, empty if all are R
+    bool coarse;  // measurements come from a coarse approximation, the iteration does not count as converged
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> h_v;
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> h_x;
+    Eigen::Matrix<T, 12, Eigen::Dynamic> h_x_T;  // transposed h_x of the first 12 states, one column per measurement
+    int dof = -1;  // measurements in the first dof columns of h_x_T, h and weight, all of them if < 0
     Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> R;
 };
 
@@ -373,6 +379,73 @@ class esekf {
 #endif
     }
 
+    // error state EKF propogation modified for one specific system (pos, rot, offset_R_L_I, offset_T_L_I, vel, bg, ba,
+    // grav). F_x is identity except for the pos/rot/vel rows, and F_w only touches rot/vel/bg/ba, so instead of the
+    // dense F * P * F^T only the affected rows and columns of P are updated.
+    void predict_modified(double &dt, processnoisecovariance &Q, const input &i_in) {
+        const Matrix<scalar_type, 3, 3> R = x_.rot.toRotationMatrix();
+        const MTK::vect<3, scalar_type> omega = i_in.gyro - x_.bg;
+        const MTK::vect<3, scalar_type> acc = i_in.acc - x_.ba;
+
+        flatted_state f_ = flatted_state::Zero();
+        f_.template block<3, 1>(0, 0) = x_.vel;
+        f_.template block<3, 1>(3, 0) = omega;
+        f_.template block<3, 1>(12, 0) = R * acc + x_.grav.get_vect();
+
+        // non-trivial blocks of F_x = I + f_x * dt
+        MTK::vect<3, scalar_type> seg_SO3 = -omega * dt;
+        MTK::SO3<scalar_type> exp_rot;
+        exp_rot.w() = MTK::exp<scalar_type, 3>(exp_rot.vec(), seg_SO3, scalar_type(0.5));
+        const Matrix<scalar_type, 3, 3> A = MTK::A_matrix(seg_SO3);
+        const Matrix<scalar_type, 3, 3> F_rot_rot = exp_rot.toRotationMatrix();
+        const Matrix<scalar_type, 3, 3> F_rot_bg = -A * dt;
+        const Matrix<scalar_type, 3, 3> F_vel_rot = -R * MTK::hat(acc) * dt;
+        const Matrix<scalar_type, 3, 3> F_vel_ba = -R * dt;
+        Matrix<scalar_type, 3, 2> F_vel_grav;
+        MTK::vect<2, scalar_type> vec = MTK::vect<2, scalar_type>::Zero();
+        x_.S2_Mx(F_vel_grav, vec, 21);
+        F_vel_grav *= dt;
+
+        // P = F_x * P, rows of pos (0), rot (3) and vel (12)
+        Matrix<scalar_type, 3, n> P_pos = P_.template block<3, n>(0, 0) + dt * P_.template block<3, n>(12, 0);
+        Matrix<scalar_type, 3, n> P_rot =
+            F_rot_rot * P_.template block<3, n>(3, 0) + F_rot_bg * P_.template block<3, n>(15, 0);
+        Matrix<scalar_type, 3, n> P_vel = P_.template block<3, n>(12, 0) + F_vel_rot * P_.template block<3, n>(3, 0) +
+                                          F_vel_ba * P_.template block<3, n>(18, 0) +
+                                          F_vel_grav * P_.template block<2, n>(21, 0);
+        P_.template block<3, n>(0, 0) = P_pos;
+        P_.template block<3, n>(3, 0) = P_rot;
+        P_.template block<3, n>(12, 0) = P_vel;
+
+        // P = P * F_x^T, same blocks on the column side
+        Matrix<scalar_type, n, 3> P_pos_t = P_.template block<n, 3>(0, 0) + dt * P_.template block<n, 3>(0, 12);
+        Matrix<scalar_type, n, 3> P_rot_t = P_.template block<n, 3>(0, 3) * F_rot_rot.transpose() +
+                                            P_.template block<n, 3>(0, 15) * F_rot_bg.transpose();
+        Matrix<scalar_type, n, 3> P_vel_t = P_.template block<n, 3>(0, 12) +
+                                            P_.template block<n, 3>(0, 3) * F_vel_rot.transpose() +
+                                            P_.template block<n, 3>(0, 18) * F_vel_ba.transpose() +
+                                            P_.template block<n, 2>(0, 21) * F_vel_grav.transpose();
+        P_.template block<n, 3>(0, 0) = P_pos_t;
+        P_.template block<n, 3>(0, 3) = P_rot_t;
+        P_.template block<n, 3>(0, 12) = P_vel_t;
+
+        // P += (F_w * dt) * Q * (F_w * dt)^T, F_w maps (ng, na, nbg, nba) onto (rot, vel, bg, ba)
+        const int w_idx[4] = {3, 12, 15, 18};
+        Matrix<scalar_type, 3, 3> G[4];
+        G[0] = -A * dt;
+        G[1] = -R * dt;
+        G[2] = Matrix<scalar_type, 3, 3>::Identity() * dt;
+        G[3] = Matrix<scalar_type, 3, 3>::Identity() * dt;
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                P_.template block<3, 3>(w_idx[a], w_idx[b]) +=
+                    G[a] * Q.template block<3, 3>(3 * a, 3 * b) * G[b].transpose();
+            }
+        }
+
+        x_.oplus(f_, dt);
+    }
+
     // iterated error state EKF update for measurement as a manifold.
     void update_iterated(measurement &z, measurementnoisecovariance &R) {
         if (!(is_same<typename measurement::scalar, scalar_type>())) {
@@ -1524,9 +1597,27 @@ class esekf {
 
     // iterated error state EKF update modified for one specific system.
     void update_iterated_dyn_share_modified(double R, double &solve_time) {
+        update_iterated_dyn_share_modified(R, solve_time, h_dyn_share);
+    }
+
+    // iterated error state EKF update modified for one specific system, the observation model is given as a callable
+    // so that it can be inlined into the iterations instead of being called through std::function.
+    template <typename ObsModel>
+    void update_iterated_dyn_share_modified(double R, double &solve_time, ObsModel &&obs_model) {
         dyn_share_datastruct<scalar_type> dyn_share;
+        update_iterated_dyn_share_modified(R, solve_time, obs_model, dyn_share);
+    }
+
+    // same, the observation model writes into the given dyn_share, so that its buffers can be kept across updates
+    template <typename ObsModel>
+    void update_iterated_dyn_share_modified(double R, double &solve_time, ObsModel &&obs_model,
+                                            dyn_share_datastruct<scalar_type> &dyn_share) {
+        static_assert(std::is_invocable<ObsModel &, state &, dyn_share_datastruct<scalar_type> &>::value,
+                      "observation model must be callable as void(state &, dyn_share_datastruct<scalar_type> &)");
+
         dyn_share.valid = true;
         dyn_share.converge = true;
+        dyn_share.coarse = false;
         int t = 0;
         state x_propagated = x_;
         cov P_propagated = P_;
@@ -1538,7 +1629,8 @@ class esekf {
         vectorized_state dx_new = vectorized_state::Zero();
         for (int i = -1; i < maximum_iter; i++) {
             dyn_share.valid = true;
-            h_dyn_share(x_, dyn_share);
+            dyn_share.coarse = false;
+            obs_model(x_, dyn_share);
 
             if (!dyn_share.valid) {
                 continue;
@@ -1547,11 +1639,17 @@ class esekf {
 // Matrix<scalar_type, Eigen::Dynamic, 1> h = h_dyn_share(x_, dyn_share);
 #ifdef USE_sparse
             spMt h_x_ = dyn_share.h_x.sparseView();
-#else
-            Eigen::Matrix<scalar_type, Eigen::Dynamic, 12> h_x_ = dyn_share.h_x;
 #endif
+            // the jacobian can be given row-wise in h_x, or column-wise in h_x_T which suits H^T * H
+            if (dyn_share.h_x.rows() > 0) {
+                dyn_share.h_x_T = dyn_share.h_x.template leftCols<12>().transpose();
+            }
             // double solve_start = omp_get_wtime();
-            dof_Measurement = h_x_.rows();
+            dof_Measurement = dyn_share.dof < 0 ? dyn_share.h_x_T.cols() : dyn_share.dof;
+            const auto h_T = dyn_share.h_x_T.leftCols(dof_Measurement);
+            const auto h = dyn_share.h.head(dof_Measurement);
+            const bool weighted = dyn_share.weight.size() >= dof_Measurement;
+            const auto weight = dyn_share.weight.head(weighted ? dof_Measurement : 0);
             vectorized_state dx;
             x_.boxminus(dx, x_propagated);
             dx_new = dx;
@@ -1622,7 +1720,7 @@ class esekf {
                 // K_temp += R_temp;
                 Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic> h_x_cur =
                     Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic>::Zero(dof_Measurement, n);
-                h_x_cur.topLeftCorner(dof_Measurement, 12) = h_x_;
+                h_x_cur.topLeftCorner(dof_Measurement, 12) = h_T.transpose();
                 /*
                 h_x_cur.col(0) = h_x_.col(0);
                 h_x_cur.col(1) = h_x_.col(1);
@@ -1638,13 +1736,14 @@ class esekf {
                 h_x_cur.col(11) = h_x_.col(11);
                 */
 
+                Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic> R_cur =
+                    Eigen::Matrix<double, Dynamic, Dynamic>::Identity(dof_Measurement, dof_Measurement);
+                if (weighted) {
+                    R_cur.diagonal() = weight.cwiseInverse();
+                }
                 Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic> K_ =
-                    P_ * h_x_cur.transpose() *
-                    (h_x_cur * P_ * h_x_cur.transpose() / R +
-                     Eigen::Matrix<double, Dynamic, Dynamic>::Identity(dof_Measurement, dof_Measurement))
-                        .inverse() /
-                    R;
-                K_h = K_ * dyn_share.h;
+                    P_ * h_x_cur.transpose() * (h_x_cur * P_ * h_x_cur.transpose() / R + R_cur).inverse() / R;
+                K_h = K_ * h;
                 K_x = K_ * h_x_cur;
                 //#else
                 //	K_= P_ * h_x.transpose() * (h_x * P_ * h_x.transpose() + h_v * R * h_v.transpose()).inverse();
@@ -1683,8 +1782,24 @@ class esekf {
                 */
 #else
                 cov P_temp = (P_ / R).inverse();
-                // Eigen::Matrix<scalar_type, 12, Eigen::Dynamic> h_T = h_x_.transpose();
-                Eigen::Matrix<scalar_type, 12, 12> HTH = h_x_.transpose() * h_x_;
+                Eigen::Matrix<scalar_type, 12, 12> HTH;
+                Eigen::Matrix<scalar_type, 12, 1> HTz;
+                if (weighted) {
+                    // H^T W in chunks of a fixed size, no temporary as large as the jacobian
+                    constexpr int CHUNK = 64;
+                    Eigen::Matrix<scalar_type, 12, CHUNK> h_T_w;
+                    HTH.setZero();
+                    HTz.setZero();
+                    for (int c = 0; c < dof_Measurement; c += CHUNK) {
+                        const int m = std::min(CHUNK, dof_Measurement - c);
+                        h_T_w.leftCols(m) = h_T.middleCols(c, m) * weight.segment(c, m).asDiagonal();
+                        HTH.noalias() += h_T_w.leftCols(m) * h_T.middleCols(c, m).transpose();
+                        HTz.noalias() += h_T_w.leftCols(m) * h.segment(c, m);
+                    }
+                } else {
+                    HTH.noalias() = h_T * h_T.transpose();
+                    HTz.noalias() = h_T * h;
+                }
                 P_temp.template block<12, 12>(0, 0) += HTH;
                 /*
                 Eigen::Matrix<scalar_type, Eigen::Dynamic, Eigen::Dynamic> h_x_cur = Eigen::Matrix<scalar_type,
@@ -1705,7 +1820,7 @@ class esekf {
                 */
                 cov P_inv = P_temp.inverse();
                 // std::cout << "line 1781" << std::endl;
-                K_h = P_inv.template block<n, 12>(0, 0) * h_x_.transpose() * dyn_share.h;
+                K_h = P_inv.template block<n, 12>(0, 0) * HTz;
                 // std::cout << "line 1780" << std::endl;
                 // cov_ HTH_cur = cov_::Zero();
                 // HTH_cur. template block<12, 12>(0, 0) = HTH;
@@ -1726,7 +1841,7 @@ class esekf {
                     break;
                 }
             }
-            if (dyn_share.converge) t++;
+            if (dyn_share.converge && !dyn_share.coarse) t++;
 
             if (!t && i == maximum_iter - 2) {
                 dyn_share.converge = true;
@@ -1844,6 +1959,8 @@ class esekf {
 
     void change_P(cov &input_cov) { P_ = input_cov; }
 
+    void change_maximum_iter(int maximum_iteration) { maximum_iter = maximum_iteration; }
+
     const state &get_x() const { return x_; }
     const cov &get_P() const { return P_; }
 
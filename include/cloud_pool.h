@@ -0,0 +1,96 @@
+#ifndef FASTER_LIO_CLOUD_POOL_H
+#define FASTER_LIO_CLOUD_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common_lib.h"
+
+namespace faster_lio {
+
+/**
+ * recycled point clouds for the buffers of a frame, e.g. an input scan or a cloud to publish
+ * a pooled cloud comes with a deleter that hands it back to the free list once its last user drops it, e.g. at the
+ * end of the frame that used it. Acquire returns it again, cleared but with the capacity it has grown to. In the
+ * steady state no point storage is allocated. The points live in the eigen aligned vector of pcl.
+ */
+class CloudPool {
+   public:
+    /// @param max_clouds  clouds kept for reuse, more clouds in flight are allocated and freed as usual
+    explicit CloudPool(size_t max_clouds = 16) : state_(std::make_shared<State>()) { state_->max_clouds_ = max_clouds; }
+
+    /// the clouds still in flight are freed when they are dropped
+    ~CloudPool() {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        for (auto cloud : state_->free_) {
+            delete cloud;
+        }
+        state_->free_.clear();
+        state_->closed_ = true;
+    }
+
+    CloudPool(const CloudPool &) = delete;
+    CloudPool &operator=(const CloudPool &) = delete;
+
+    /// an empty cloud, thread safe
+    CloudPtr Acquire() {
+        PointCloudType *cloud = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(state_->mtx_);
+            if (!state_->free_.empty()) {
+                cloud = state_->free_.back();
+                state_->free_.pop_back();
+            } else if (state_->num_clouds_ >= state_->max_clouds_) {
+                return CloudPtr(new PointCloudType());
+            } else {
+                state_->num_clouds_++;
+            }
+        }
+
+        if (cloud == nullptr) {
+            cloud = new PointCloudType();
+        }
+        // the capacity is counted in Bytes until the cloud comes back
+        const size_t bytes = cloud->points.capacity() * sizeof(PointType);
+        std::shared_ptr<State> state = state_;
+        return CloudPtr(cloud, [state, bytes](PointCloudType *returned) { state->Release(returned, bytes); });
+    }
+
+    /// capacity of the points of all pooled clouds, the ones in use as of their last release
+    size_t Bytes() const {
+        std::lock_guard<std::mutex> lock(state_->mtx_);
+        return state_->bytes_;
+    }
+
+   private:
+    /// shared with the deleters, so a cloud may outlive the pool
+    struct State {
+        /// back to the free list, cleared but with its capacity
+        void Release(PointCloudType *cloud, size_t acquired_bytes) {
+            cloud->clear();
+            const size_t bytes = cloud->points.capacity() * sizeof(PointType);
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (closed_) {
+                delete cloud;
+                return;
+            }
+            bytes_ = bytes_ + bytes - acquired_bytes;
+            free_.emplace_back(cloud);
+        }
+
+        std::mutex mtx_;
+        size_t max_clouds_ = 0;
+        size_t num_clouds_ = 0;               // pooled clouds, in use or free
+        size_t bytes_ = 0;                    // see Bytes
+        bool closed_ = false;                 // the pool is gone, returned clouds are freed
+        std::vector<PointCloudType *> free_;  // clouds nobody holds
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_CLOUD_POOL_H
@@ -1,19 +1,16 @@
 #ifndef COMMON_LIB_H
 #define COMMON_LIB_H
 
-#include <eigen_conversions/eigen_msg.h>
-#include <nav_msgs/Odometry.h>
-#include <sensor_msgs/Imu.h>
-
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
 #include <Eigen/Core>
 #include <Eigen/Dense>
-#include <boost/array.hpp>
+#include <algorithm>
+#include <array>
+#include <deque>
 #include <unsupported/Eigen/ArpackSupport>
 
-#include "faster_lio/Pose6D.h"
 #include "options.h"
 #include "so3_math.h"
 
@@ -32,7 +29,7 @@ inline Eigen::Matrix<S, 3, 1> VecFromArray(const std::vector<double> &v) {
 }
 
 template <typename S>
-inline Eigen::Matrix<S, 3, 1> VecFromArray(const boost::array<S, 3> &v) {
+inline Eigen::Matrix<S, 3, 1> VecFromArray(const std::array<S, 3> &v) {
     return Eigen::Matrix<S, 3, 1>(v[0], v[1], v[2]);
 }
 
@@ -44,7 +41,7 @@ inline Eigen::Matrix<S, 3, 3> MatFromArray(const std::vector<double> &v) {
 }
 
 template <typename S>
-inline Eigen::Matrix<S, 3, 3> MatFromArray(const boost::array<S, 9> &v) {
+inline Eigen::Matrix<S, 3, 3> MatFromArray(const std::array<S, 9> &v) {
     Eigen::Matrix<S, 3, 3> m;
     m << v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8];
     return m;
@@ -52,7 +49,6 @@ inline Eigen::Matrix<S, 3, 3> MatFromArray(const boost::array<S, 9> &v) {
 
 inline std::string DEBUG_FILE_DIR(const std::string &name) { return std::string(ROOT_DIR) + "Log/" + name; }
 
-using Pose6D = faster_lio::Pose6D;
 using V3D = Eigen::Vector3d;
 using V4D = Eigen::Vector4d;
 using V5D = Eigen::Matrix<double, 5, 1>;
@@ -76,6 +72,23 @@ const M3F Eye3f = M3F::Identity();
 const V3D Zero3d(0, 0, 0);
 const V3F Zero3f(0, 0, 0);
 
+/// the preintegrated lidar states at the time of imu measurements in a frame
+struct Pose6D {
+    double offset_time = 0;     // the offset time of imu measurement w.r.t the first lidar point
+    std::array<double, 3> acc;  // the preintegrated total acceleration (global frame) at the lidar origin
+    std::array<double, 3> gyr;  // the unbiased angular velocity (body frame) at the lidar origin
+    std::array<double, 3> vel;  // the preintegrated velocity (global frame) at the lidar origin
+    std::array<double, 3> pos;  // the preintegrated position (global frame) at the lidar origin
+    std::array<double, 9> rot;  // the preintegrated rotation (global frame) at the lidar origin
+};
+
+/// one imu sample
+struct ImuData {
+    double timestamp_ = 0;    // in seconds
+    V3D acc_ = V3D::Zero();   // linear acceleration
+    V3D gyro_ = V3D::Zero();  // angular velocity
+};
+
 /// sync imu and lidar measurements
 struct MeasureGroup {
     MeasureGroup() { this->lidar_.reset(new PointCloudType()); };
@@ -83,7 +96,7 @@ struct MeasureGroup {
     double lidar_bag_time_ = 0;
     double lidar_end_time_ = 0;
     PointCloudType::Ptr lidar_ = nullptr;
-    std::deque<sensor_msgs::Imu::ConstPtr> imu_;
+    std::deque<ImuData> imu_;
 };
 
 template <typename T>
@@ -175,23 +188,105 @@ inline float calc_dist(const PointType &p1, const PointType &p2) {
 
 inline float calc_dist(const Eigen::Vector3f &p1, const Eigen::Vector3f &p2) { return (p1 - p2).squaredNorm(); }
 
+/// robust kernels for the point-to-plane residuals
+enum class RobustKernel { NONE = 0, HUBER = 1, CAUCHY = 2 };
+
+/**
+ * IRLS weight of a residual under the given robust kernel
+ * @param kernel robust kernel type
+ * @param r residual
+ * @param delta kernel width
+ * @return weight in (0, 1]
+ */
+inline float robust_weight(const RobustKernel &kernel, const float &r, const float &delta) {
+    const float abs_r = std::fabs(r);
+    switch (kernel) {
+        case RobustKernel::HUBER:
+            return abs_r <= delta ? 1.0f : delta / abs_r;
+        case RobustKernel::CAUCHY:
+            return 1.0f / (1.0f + (r * r) / (delta * delta));
+        default:
+            return 1.0f;
+    }
+}
+
+/**
+ * variance of a lidar point along the normal of its matched plane
+ * range noise acts along the ray and bearing noise across it, so far points at grazing incidence get large variance;
+ * the spread of the neighbours around the fitted plane is added on top
+ * @param ray ray from the lidar to the point, in the same frame as the plane
+ * @param plane plane coeffs (normalized normal, d)
+ * @param points_near neighbours used for the plane fit
+ * @param num number of neighbours
+ * @param range_sigma std of the range measurement
+ * @param bearing_sigma std of the beam direction in rad
+ * @return variance of the point-to-plane residual
+ */
+inline float point_plane_variance(const Eigen::Vector3f &ray, const Eigen::Vector4f &plane,
+                                  const PointType *points_near, const int &num, const float &range_sigma,
+                                  const float &bearing_sigma) {
+    const float range = ray.norm();
+    const float cos_incidence = range > 1e-6 ? std::fabs(plane.head<3>().dot(ray)) / range : 1.0f;
+    const float sin2_incidence = std::max(0.0f, 1.0f - cos_incidence * cos_incidence);
+    const float bearing_std = range * bearing_sigma;
+
+    float spread = 0;
+    for (int j = 0; j < num; j++) {
+        Eigen::Vector4f temp = points_near[j].getVector4fMap();
+        temp[3] = 1.0;
+        const float d = plane.dot(temp);
+        spread += d * d;
+    }
+    spread /= std::max(num, 1);
+
+    return range_sigma * range_sigma * cos_incidence * cos_incidence + bearing_std * bearing_std * sin2_incidence +
+           spread;
+}
+
+/// residual of the lidar points against the map
+enum class ResidualType { POINT_TO_PLANE = 0, POINT_TO_DISTRIBUTION = 1 };
+
+/**
+ * split a gaussian into three planes through its mean along the principal axes
+ * the mahalanobis distance of a point is then the sum of its squared distances to the planes divided by the variances,
+ * so the distribution residual fits the point-to-plane jacobian of the filter
+ * @param mean mean of the distribution
+ * @param cov covariance of the distribution
+ * @param min_variance added to the variance along each axis
+ * @param planes output plane coeffs (axis, -axis.dot(mean)), 3 of them
+ * @param variances output variance along each axis, 3 of them
+ */
+inline void distribution_to_planes(const Eigen::Vector3f &mean, const Eigen::Matrix3f &cov, const float &min_variance,
+                                   Eigen::Vector4f *planes, float *variances) {
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> es;
+    es.computeDirect(cov);
+    for (int k = 0; k < 3; k++) {
+        const Eigen::Vector3f axis = es.eigenvectors().col(k);
+        planes[k].head<3>() = axis;
+        planes[k][3] = -axis.dot(mean);
+        variances[k] = std::max(es.eigenvalues()[k], 0.0f) + min_variance;
+    }
+}
+
 /**
  * estimate a plane
  * @tparam T
  * @param pca_result
  * @param point
+ * @param num
  * @param threshold
  * @return
  */
 template <typename T>
-inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointVector &point, const T &threshold = 0.1f) {
-    if (point.size() < options::MIN_NUM_MATCH_POINTS) {
+inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointType *point, const int &num,
+                       const T &threshold = 0.1f) {
+    if (num < options::MIN_NUM_MATCH_POINTS) {
         return false;
     }
 
     Eigen::Matrix<T, 3, 1> normvec;
 
-    if (point.size() == options::NUM_MATCH_POINTS) {
+    if (num == options::NUM_MATCH_POINTS) {
         Eigen::Matrix<T, options::NUM_MATCH_POINTS, 3> A;
         Eigen::Matrix<T, options::NUM_MATCH_POINTS, 1> b;
 
@@ -206,15 +301,34 @@ inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointVector &po
         }
 
         normvec = A.colPivHouseholderQr().solve(b);
+    } else if (num < options::NUM_MATCH_POINTS) {
+        // fewer neighbours, bounded size so it stays on the stack
+        Eigen::Matrix<double, Eigen::Dynamic, 3, 0, options::NUM_MATCH_POINTS, 3> A(num, 3);
+        Eigen::Matrix<double, Eigen::Dynamic, 1, 0, options::NUM_MATCH_POINTS, 1> b(num, 1);
+
+        A.setZero();
+        b.setOnes();
+        b *= -1.0f;
+
+        for (int j = 0; j < num; j++) {
+            A(j, 0) = point[j].x;
+            A(j, 1) = point[j].y;
+            A(j, 2) = point[j].z;
+        }
+
+        Eigen::Vector3d n = A.colPivHouseholderQr().solve(b);
+        normvec(0, 0) = n(0, 0);
+        normvec(1, 0) = n(1, 0);
+        normvec(2, 0) = n(2, 0);
     } else {
-        Eigen::MatrixXd A(point.size(), 3);
-        Eigen::VectorXd b(point.size(), 1);
+        Eigen::MatrixXd A(num, 3);
+        Eigen::VectorXd b(num, 1);
 
         A.setZero();
         b.setOnes();
         b *= -1.0f;
 
-        for (int j = 0; j < point.size(); j++) {
+        for (int j = 0; j < num; j++) {
             A(j, 0) = point[j].x;
             A(j, 1) = point[j].y;
             A(j, 2) = point[j].z;
@@ -232,8 +346,8 @@ inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointVector &po
     pca_result(2) = normvec(2) / n;
     pca_result(3) = 1.0 / n;
 
-    for (const auto &p : point) {
-        Eigen::Matrix<T, 4, 1> temp = p.getVector4fMap();
+    for (int j = 0; j < num; j++) {
+        Eigen::Matrix<T, 4, 1> temp = point[j].getVector4fMap();
         temp[3] = 1.0;
         if (fabs(pca_result.dot(temp)) > threshold) {
             return false;
@@ -242,5 +356,18 @@ inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointVector &po
     return true;
 }
 
+/**
+ * estimate a plane
+ * @tparam T
+ * @param pca_result
+ * @param point
+ * @param threshold
+ * @return
+ */
+template <typename T>
+inline bool esti_plane(Eigen::Matrix<T, 4, 1> &pca_result, const PointVector &point, const T &threshold = 0.1f) {
+    return esti_plane(pca_result, point.data(), static_cast<int>(point.size()), threshold);
+}
+
 }  // namespace faster_lio::common
 #endif
\ No newline at end of file
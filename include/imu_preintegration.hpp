@@ -0,0 +1,209 @@
+#ifndef FASTER_LIO_IMU_PREINTEGRATION_H
+#define FASTER_LIO_IMU_PREINTEGRATION_H
+
+#include <Eigen/Core>
+
+#include "use-ikfom.hpp"
+
+namespace faster_lio {
+
+/**
+ * IMU preintegration between two lidar frames
+ *
+ * The IMU samples of one frame are accumulated into delta R/v/p w.r.t. the state at the frame beginning, together with
+ * the error state transition of the nav states (pos, rot, vel) and the accumulated process noise, both in compact
+ * fixed-size form. The covariance of the filter is then propagated only once per frame in Apply(), which gives the
+ * same result as calling esekf::predict_modified for every sample.
+ *
+ * error state indices follow state_ikfom: pos 0, rot 3, vel 12, bg 15, ba 18, grav 21
+ */
+class ImuPreintegration {
+   public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    using KFType = esekfom::esekf<state_ikfom, 12, input_ikfom>;
+
+    /// compact columns: pos, rot, vel, bg, ba (3 each), grav (2)
+    static constexpr int COLS = 17;
+    /// noise only enters pos, rot, vel, bg, ba
+    static constexpr int NOISE_DIM = 15;
+
+    /// start a new integration from the given state
+    void Reset(const state_ikfom &x0) {
+        x0_ = x0;
+        R0_ = x0.rot.toRotationMatrix();
+        delta_rot_ = SO3();
+        delta_vel_.setZero();
+        delta_pos_.setZero();
+        delta_t_ = 0;
+        grav_pos_coeff_ = 0;
+
+        phi_.setZero();
+        phi_.block<3, 3>(0, 0).setIdentity();
+        phi_.block<3, 3>(3, 3).setIdentity();
+        phi_.block<3, 3>(6, 6).setIdentity();
+        cov_.setZero();
+
+        Eigen::Matrix<double, 2, 1> vec = Eigen::Matrix<double, 2, 1>::Zero();
+        x0_.S2_Mx(grav_mx_, vec, 21);
+    }
+
+    /**
+     * integrate one IMU sample (mid-point acc and gyro, already scaled to m/s^2)
+     * @param acc  acceleration measurement
+     * @param gyr  angular velocity measurement
+     * @param dt   time step
+     * @param Q    process noise covariance (ng, na, nbg, nba)
+     */
+    void Integrate(const Eigen::Vector3d &acc, const Eigen::Vector3d &gyr, double dt,
+                   const Eigen::Matrix<double, 12, 12> &Q) {
+        const Eigen::Vector3d omega = gyr - x0_.bg;
+        const vect3 acc_unbias = acc - x0_.ba;
+        const Eigen::Matrix3d R = R0_ * delta_rot_.toRotationMatrix();
+
+        // per-step jacobians, same as esekf::predict_modified
+        vect3 seg_SO3 = -omega * dt;
+        SO3 exp_rot;
+        exp_rot.w() = MTK::exp<double, 3>(exp_rot.vec(), seg_SO3, 0.5);
+        const Eigen::Matrix3d A = MTK::A_matrix(seg_SO3);
+        const Eigen::Matrix3d F_rot_rot = exp_rot.toRotationMatrix();
+        const Eigen::Matrix3d F_rot_bg = -A * dt;
+        const Eigen::Matrix3d F_vel_rot = -R * MTK::hat(acc_unbias) * dt;
+        const Eigen::Matrix3d F_vel_ba = -R * dt;
+        const Eigen::Matrix<double, 3, 2> F_vel_grav = grav_mx_ * dt;
+
+        // transition of nav rows: phi = F * phi, rows of bg/ba/grav stay identity
+        Eigen::Matrix<double, 3, COLS> phi_pos = phi_.block<3, COLS>(0, 0) + dt * phi_.block<3, COLS>(6, 0);
+        Eigen::Matrix<double, 3, COLS> phi_rot = F_rot_rot * phi_.block<3, COLS>(3, 0);
+        phi_rot.block<3, 3>(0, 9) += F_rot_bg;
+        Eigen::Matrix<double, 3, COLS> phi_vel = phi_.block<3, COLS>(6, 0) + F_vel_rot * phi_.block<3, COLS>(3, 0);
+        phi_vel.block<3, 3>(0, 12) += F_vel_ba;
+        phi_vel.block<3, 2>(0, 15) += F_vel_grav;
+        phi_.block<3, COLS>(0, 0) = phi_pos;
+        phi_.block<3, COLS>(3, 0) = phi_rot;
+        phi_.block<3, COLS>(6, 0) = phi_vel;
+
+        // noise: cov = F * cov * F^T + G * Q * G^T, compact order pos, rot, vel, bg, ba
+        Eigen::Matrix<double, 3, NOISE_DIM> c_pos =
+            cov_.block<3, NOISE_DIM>(0, 0) + dt * cov_.block<3, NOISE_DIM>(6, 0);
+        Eigen::Matrix<double, 3, NOISE_DIM> c_rot =
+            F_rot_rot * cov_.block<3, NOISE_DIM>(3, 0) + F_rot_bg * cov_.block<3, NOISE_DIM>(9, 0);
+        Eigen::Matrix<double, 3, NOISE_DIM> c_vel = cov_.block<3, NOISE_DIM>(6, 0) +
+                                                    F_vel_rot * cov_.block<3, NOISE_DIM>(3, 0) +
+                                                    F_vel_ba * cov_.block<3, NOISE_DIM>(12, 0);
+        cov_.block<3, NOISE_DIM>(0, 0) = c_pos;
+        cov_.block<3, NOISE_DIM>(3, 0) = c_rot;
+        cov_.block<3, NOISE_DIM>(6, 0) = c_vel;
+
+        Eigen::Matrix<double, NOISE_DIM, 3> c_pos_t =
+            cov_.block<NOISE_DIM, 3>(0, 0) + dt * cov_.block<NOISE_DIM, 3>(0, 6);
+        Eigen::Matrix<double, NOISE_DIM, 3> c_rot_t = cov_.block<NOISE_DIM, 3>(0, 3) * F_rot_rot.transpose() +
+                                                      cov_.block<NOISE_DIM, 3>(0, 9) * F_rot_bg.transpose();
+        Eigen::Matrix<double, NOISE_DIM, 3> c_vel_t = cov_.block<NOISE_DIM, 3>(0, 6) +
+                                                      cov_.block<NOISE_DIM, 3>(0, 3) * F_vel_rot.transpose() +
+                                                      cov_.block<NOISE_DIM, 3>(0, 12) * F_vel_ba.transpose();
+        cov_.block<NOISE_DIM, 3>(0, 0) = c_pos_t;
+        cov_.block<NOISE_DIM, 3>(0, 3) = c_rot_t;
+        cov_.block<NOISE_DIM, 3>(0, 6) = c_vel_t;
+
+        const int w_idx[4] = {3, 6, 9, 12};
+        Eigen::Matrix3d G[4];
+        G[0] = -A * dt;
+        G[1] = -R * dt;
+        G[2] = Eigen::Matrix3d::Identity() * dt;
+        G[3] = Eigen::Matrix3d::Identity() * dt;
+        for (int a = 0; a < 4; a++) {
+            for (int b = 0; b < 4; b++) {
+                cov_.block<3, 3>(w_idx[a], w_idx[b]) += G[a] * Q.block<3, 3>(3 * a, 3 * b) * G[b].transpose();
+            }
+        }
+
+        // deltas, the integration order is the same with state_ikfom::oplus
+        delta_pos_ += delta_vel_ * dt;
+        grav_pos_coeff_ += delta_t_ * dt;
+        delta_vel_ += delta_rot_.toRotationMatrix() * acc_unbias * dt;
+        delta_rot_.oplus(omega, dt);
+        delta_t_ += dt;
+    }
+
+    /// propagate the filter state and covariance over the whole integration in one step
+    void Apply(KFType &kf) const {
+        state_ikfom x = GetState();
+        kf.change_x(x);
+
+        constexpr int n = state_ikfom::DOF;
+        const int col_idx[6] = {0, 3, 12, 15, 18, 21};
+        const int col_dim[6] = {3, 3, 3, 3, 3, 2};
+
+        KFType::cov P = kf.get_P();
+
+        // P = Phi * P * Phi^T, Phi is identity except the pos/rot/vel rows
+        Eigen::Matrix<double, COLS, n> P_rows;
+        for (int i = 0, c = 0; i < 6; c += col_dim[i], i++) {
+            P_rows.block(c, 0, col_dim[i], n) = P.block(col_idx[i], 0, col_dim[i], n);
+        }
+        Eigen::Matrix<double, 9, n> nav_rows = phi_ * P_rows;
+        P.block<3, n>(0, 0) = nav_rows.block<3, n>(0, 0);
+        P.block<3, n>(3, 0) = nav_rows.block<3, n>(3, 0);
+        P.block<3, n>(12, 0) = nav_rows.block<3, n>(6, 0);
+
+        Eigen::Matrix<double, n, COLS> P_cols;
+        for (int i = 0, c = 0; i < 6; c += col_dim[i], i++) {
+            P_cols.block(0, c, n, col_dim[i]) = P.block(0, col_idx[i], n, col_dim[i]);
+        }
+        Eigen::Matrix<double, n, 9> nav_cols = P_cols * phi_.transpose();
+        P.block<n, 3>(0, 0) = nav_cols.block<n, 3>(0, 0);
+        P.block<n, 3>(0, 3) = nav_cols.block<n, 3>(0, 3);
+        P.block<n, 3>(0, 12) = nav_cols.block<n, 3>(0, 6);
+
+        // P += accumulated noise
+        for (int a = 0; a < 5; a++) {
+            for (int b = 0; b < 5; b++) {
+                P.block<3, 3>(col_idx[a], col_idx[b]) += cov_.block<3, 3>(3 * a, 3 * b);
+            }
+        }
+
+        kf.change_P(P);
+    }
+
+    /// predicted nominal state at the current integration time
+    state_ikfom GetState() const {
+        state_ikfom x = x0_;
+        x.rot = x0_.rot * delta_rot_;
+        x.vel = Vel();
+        x.pos = Pos();
+        return x;
+    }
+
+    /// current rotation/velocity/position in world frame
+    Eigen::Matrix3d Rot() const { return R0_ * delta_rot_.toRotationMatrix(); }
+    Eigen::Vector3d Vel() const { return x0_.vel + x0_.grav.get_vect() * delta_t_ + R0_ * delta_vel_; }
+    Eigen::Vector3d Pos() const {
+        return x0_.pos + x0_.vel * delta_t_ + x0_.grav.get_vect() * grav_pos_coeff_ + R0_ * delta_pos_;
+    }
+
+    const SO3 &DeltaRot() const { return delta_rot_; }
+    const Eigen::Vector3d &DeltaVel() const { return delta_vel_; }
+    const Eigen::Vector3d &DeltaPos() const { return delta_pos_; }
+    double DeltaTime() const { return delta_t_; }
+    const Eigen::Matrix<double, 9, COLS> &Transition() const { return phi_; }
+    const Eigen::Matrix<double, NOISE_DIM, NOISE_DIM> &NoiseCov() const { return cov_; }
+
+   private:
+    state_ikfom x0_;  // state at the beginning
+    Eigen::Matrix3d R0_ = Eigen::Matrix3d::Identity();
+    Eigen::Matrix<double, 3, 2> grav_mx_ = Eigen::Matrix<double, 3, 2>::Zero();
+
+    SO3 delta_rot_;
+    Eigen::Vector3d delta_vel_ = Eigen::Vector3d::Zero();
+    Eigen::Vector3d delta_pos_ = Eigen::Vector3d::Zero();
+    double delta_t_ = 0;
+    double grav_pos_coeff_ = 0;  // sum of t_k * dt_k, the gravity term of the position
+
+    Eigen::Matrix<double, 9, COLS> phi_ = Eigen::Matrix<double, 9, COLS>::Zero();  // d(pos, rot, vel) / d(x0)
+    Eigen::Matrix<double, NOISE_DIM, NOISE_DIM> cov_ = Eigen::Matrix<double, NOISE_DIM, NOISE_DIM>::Zero();
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_IMU_PREINTEGRATION_H
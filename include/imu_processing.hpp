@@ -2,14 +2,11 @@
 #define FASTER_LIO_IMU_PROCESSING_H
 
 #include <glog/logging.h>
-#include <nav_msgs/Odometry.h>
-#include <sensor_msgs/Imu.h>
-#include <sensor_msgs/PointCloud2.h>
 #include <cmath>
 #include <deque>
-#include <fstream>
 
 #include "common_lib.h"
+#include "imu_preintegration.hpp"
 #include "so3_math.h"
 #include "use-ikfom.hpp"
 #include "utils.h"
@@ -18,26 +15,30 @@ namespace faster_lio {
 
 constexpr int MAX_INI_COUNT = 20;
 
-bool time_list(const PointType &x, const PointType &y) { return (x.curvature < y.curvature); };
+inline bool time_list(const PointType &x, const PointType &y) { return (x.curvature < y.curvature); };
 
 /// IMU Process and undistortion
 class ImuProcess {
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    ImuProcess();
+    struct Options {
+        common::V3D gyr_cov_ = common::V3D::Constant(0.1);  // gyroscope noise, used once the imu is initialized
+        common::V3D acc_cov_ = common::V3D::Constant(0.1);  // accelerometer noise, used once the imu is initialized
+        common::V3D b_gyr_cov_ = common::V3D::Constant(0.0001);
+        common::V3D b_acc_cov_ = common::V3D::Constant(0.0001);
+        common::V3D extrinsic_T_ = common::Zero3d;  // lidar in imu
+        common::M3D extrinsic_R_ = common::Eye3d;
+    };
+
+    /// stage timings go to the timer of the owning estimator
+    ImuProcess(const Options &options, Timer &timer);
     ~ImuProcess();
 
     void Reset();
-    void SetExtrinsic(const common::V3D &transl, const common::M3D &rot);
-    void SetGyrCov(const common::V3D &scaler);
-    void SetAccCov(const common::V3D &scaler);
-    void SetGyrBiasCov(const common::V3D &b_g);
-    void SetAccBiasCov(const common::V3D &b_a);
     void Process(const common::MeasureGroup &meas, esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
                  PointCloudType::Ptr pcl_un_);
 
-    std::ofstream fout_imu_;
     Eigen::Matrix<double, 12, 12> Q_;
     common::V3D cov_acc_;
     common::V3D cov_gyr_;
@@ -51,11 +52,13 @@ class ImuProcess {
     void UndistortPcl(const common::MeasureGroup &meas, esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
                       PointCloudType &pcl_out);
 
+    Timer &timer_;
     PointCloudType::Ptr cur_pcl_un_;
-    sensor_msgs::ImuConstPtr last_imu_;
-    std::deque<sensor_msgs::ImuConstPtr> v_imu_;
+    common::ImuData last_imu_;
+    std::vector<common::ImuData> v_imu_;  // imu of the current frame with the last one of the previous frame
     std::vector<common::Pose6D> IMUpose_;
     std::vector<common::M3D> v_rot_pcl_;
+    ImuPreintegration preintegration_;
     common::M3D Lidar_R_wrt_IMU_;
     common::V3D Lidar_T_wrt_IMU_;
     common::V3D mean_acc_;
@@ -68,24 +71,27 @@ class ImuProcess {
     bool imu_need_init_ = true;
 };
 
-ImuProcess::ImuProcess() : b_first_frame_(true), imu_need_init_(true) {
+inline ImuProcess::ImuProcess(const Options &options, Timer &timer)
+    : timer_(timer), b_first_frame_(true), imu_need_init_(true) {
     init_iter_num_ = 1;
     Q_ = process_noise_cov();
     cov_acc_ = common::V3D(0.1, 0.1, 0.1);
     cov_gyr_ = common::V3D(0.1, 0.1, 0.1);
-    cov_bias_gyr_ = common::V3D(0.0001, 0.0001, 0.0001);
-    cov_bias_acc_ = common::V3D(0.0001, 0.0001, 0.0001);
+    cov_acc_scale_ = options.acc_cov_;
+    cov_gyr_scale_ = options.gyr_cov_;
+    cov_bias_gyr_ = options.b_gyr_cov_;
+    cov_bias_acc_ = options.b_acc_cov_;
     mean_acc_ = common::V3D(0, 0, -1.0);
     mean_gyr_ = common::V3D(0, 0, 0);
     angvel_last_ = common::Zero3d;
-    Lidar_T_wrt_IMU_ = common::Zero3d;
-    Lidar_R_wrt_IMU_ = common::Eye3d;
-    last_imu_.reset(new sensor_msgs::Imu());
+    Lidar_T_wrt_IMU_ = options.extrinsic_T_;
+    Lidar_R_wrt_IMU_ = options.extrinsic_R_;
+    last_imu_ = common::ImuData();
 }
 
-ImuProcess::~ImuProcess() {}
+inline ImuProcess::~ImuProcess() {}
 
-void ImuProcess::Reset() {
+inline void ImuProcess::Reset() {
     mean_acc_ = common::V3D(0, 0, -1.0);
     mean_gyr_ = common::V3D(0, 0, 0);
     angvel_last_ = common::Zero3d;
@@ -93,25 +99,12 @@ void ImuProcess::Reset() {
     init_iter_num_ = 1;
     v_imu_.clear();
     IMUpose_.clear();
-    last_imu_.reset(new sensor_msgs::Imu());
+    last_imu_ = common::ImuData();
     cur_pcl_un_.reset(new PointCloudType());
 }
 
-void ImuProcess::SetExtrinsic(const common::V3D &transl, const common::M3D &rot) {
-    Lidar_T_wrt_IMU_ = transl;
-    Lidar_R_wrt_IMU_ = rot;
-}
-
-void ImuProcess::SetGyrCov(const common::V3D &scaler) { cov_gyr_scale_ = scaler; }
-
-void ImuProcess::SetAccCov(const common::V3D &scaler) { cov_acc_scale_ = scaler; }
-
-void ImuProcess::SetGyrBiasCov(const common::V3D &b_g) { cov_bias_gyr_ = b_g; }
-
-void ImuProcess::SetAccBiasCov(const common::V3D &b_a) { cov_bias_acc_ = b_a; }
-
-void ImuProcess::IMUInit(const common::MeasureGroup &meas, esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
-                         int &N) {
+inline void ImuProcess::IMUInit(const common::MeasureGroup &meas,
+                                esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state, int &N) {
     /** 1. initializing the gravity_, gyro bias, acc and gyro covariance
      ** 2. normalize the acceleration measurenments to unit gravity_ **/
 
@@ -121,17 +114,13 @@ void ImuProcess::IMUInit(const common::MeasureGroup &meas, esekfom::esekf<state_
         Reset();
         N = 1;
         b_first_frame_ = false;
-        const auto &imu_acc = meas.imu_.front()->linear_acceleration;
-        const auto &gyr_acc = meas.imu_.front()->angular_velocity;
-        mean_acc_ << imu_acc.x, imu_acc.y, imu_acc.z;
-        mean_gyr_ << gyr_acc.x, gyr_acc.y, gyr_acc.z;
+        mean_acc_ = meas.imu_.front().acc_;
+        mean_gyr_ = meas.imu_.front().gyro_;
     }
 
     for (const auto &imu : meas.imu_) {
-        const auto &imu_acc = imu->linear_acceleration;
-        const auto &gyr_acc = imu->angular_velocity;
-        cur_acc << imu_acc.x, imu_acc.y, imu_acc.z;
-        cur_gyr << gyr_acc.x, gyr_acc.y, gyr_acc.z;
+        cur_acc = imu.acc_;
+        cur_gyr = imu.gyro_;
 
         mean_acc_ += (cur_acc - mean_acc_) / N;
         mean_gyr_ += (cur_gyr - mean_gyr_) / N;
@@ -162,13 +151,14 @@ void ImuProcess::IMUInit(const common::MeasureGroup &meas, esekfom::esekf<state_
     last_imu_ = meas.imu_.back();
 }
 
-void ImuProcess::UndistortPcl(const common::MeasureGroup &meas, esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
-                              PointCloudType &pcl_out) {
+inline void ImuProcess::UndistortPcl(const common::MeasureGroup &meas,
+                                     esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state, PointCloudType &pcl_out) {
     /*** add the imu_ of the last frame-tail to the of current frame-head ***/
-    auto v_imu = meas.imu_;
-    v_imu.push_front(last_imu_);
-    const double &imu_beg_time = v_imu.front()->header.stamp.toSec();
-    const double &imu_end_time = v_imu.back()->header.stamp.toSec();
+    v_imu_.clear();
+    v_imu_.push_back(last_imu_);
+    v_imu_.insert(v_imu_.end(), meas.imu_.begin(), meas.imu_.end());
+    const double &imu_beg_time = v_imu_.front().timestamp_;
+    const double &imu_end_time = v_imu_.back().timestamp_;
     const double &pcl_beg_time = meas.lidar_bag_time_;
     const double &pcl_end_time = meas.lidar_end_time_;
 
@@ -181,62 +171,60 @@ void ImuProcess::UndistortPcl(const common::MeasureGroup &meas, esekfom::esekf<s
     IMUpose_.clear();
     IMUpose_.push_back(common::set_pose6d(0.0, acc_s_last_, angvel_last_, imu_state.vel, imu_state.pos,
                                           imu_state.rot.toRotationMatrix()));
+    preintegration_.Reset(imu_state);
 
     /*** forward propagation at each imu_ point ***/
-    common::V3D angvel_avr, acc_avr, acc_imu, vel_imu, pos_imu;
+    common::V3D angvel_avr = common::Zero3d, acc_avr = common::Zero3d, acc_imu, vel_imu, pos_imu;
     common::M3D R_imu;
 
     double dt = 0;
 
-    input_ikfom in;
-    for (auto it_imu = v_imu.begin(); it_imu < (v_imu.end() - 1); it_imu++) {
+    Q_.block<3, 3>(0, 0).diagonal() = cov_gyr_;
+    Q_.block<3, 3>(3, 3).diagonal() = cov_acc_;
+    Q_.block<3, 3>(6, 6).diagonal() = cov_bias_gyr_;
+    Q_.block<3, 3>(9, 9).diagonal() = cov_bias_acc_;
+
+    for (auto it_imu = v_imu_.begin(); it_imu < (v_imu_.end() - 1); it_imu++) {
         auto &&head = *(it_imu);
         auto &&tail = *(it_imu + 1);
 
-        if (tail->header.stamp.toSec() < last_lidar_end_time_) {
+        if (tail.timestamp_ < last_lidar_end_time_) {
             continue;
         }
 
-        angvel_avr << 0.5 * (head->angular_velocity.x + tail->angular_velocity.x),
-            0.5 * (head->angular_velocity.y + tail->angular_velocity.y),
-            0.5 * (head->angular_velocity.z + tail->angular_velocity.z);
-        acc_avr << 0.5 * (head->linear_acceleration.x + tail->linear_acceleration.x),
-            0.5 * (head->linear_acceleration.y + tail->linear_acceleration.y),
-            0.5 * (head->linear_acceleration.z + tail->linear_acceleration.z);
+        angvel_avr = 0.5 * (head.gyro_ + tail.gyro_);
+        acc_avr = 0.5 * (head.acc_ + tail.acc_);
 
         acc_avr = acc_avr * common::G_m_s2 / mean_acc_.norm();  // - state_inout.ba;
 
-        if (head->header.stamp.toSec() < last_lidar_end_time_) {
-            dt = tail->header.stamp.toSec() - last_lidar_end_time_;
+        if (head.timestamp_ < last_lidar_end_time_) {
+            dt = tail.timestamp_ - last_lidar_end_time_;
         } else {
-            dt = tail->header.stamp.toSec() - head->header.stamp.toSec();
+            dt = tail.timestamp_ - head.timestamp_;
         }
 
-        in.acc = acc_avr;
-        in.gyro = angvel_avr;
-        Q_.block<3, 3>(0, 0).diagonal() = cov_gyr_;
-        Q_.block<3, 3>(3, 3).diagonal() = cov_acc_;
-        Q_.block<3, 3>(6, 6).diagonal() = cov_bias_gyr_;
-        Q_.block<3, 3>(9, 9).diagonal() = cov_bias_acc_;
-        kf_state.predict(dt, Q_, in);
+        preintegration_.Integrate(acc_avr, angvel_avr, dt, Q_);
 
         /* save the poses at each IMU measurements */
-        imu_state = kf_state.get_x();
+        R_imu = preintegration_.Rot();
         angvel_last_ = angvel_avr - imu_state.bg;
-        acc_s_last_ = imu_state.rot * (acc_avr - imu_state.ba);
+        acc_s_last_ = R_imu * (acc_avr - imu_state.ba);
         for (int i = 0; i < 3; i++) {
             acc_s_last_[i] += imu_state.grav[i];
         }
 
-        double &&offs_t = tail->header.stamp.toSec() - pcl_beg_time;
-        IMUpose_.emplace_back(common::set_pose6d(offs_t, acc_s_last_, angvel_last_, imu_state.vel, imu_state.pos,
-                                                 imu_state.rot.toRotationMatrix()));
+        double &&offs_t = tail.timestamp_ - pcl_beg_time;
+        IMUpose_.emplace_back(
+            common::set_pose6d(offs_t, acc_s_last_, angvel_last_, preintegration_.Vel(), preintegration_.Pos(), R_imu));
     }
 
     /*** calculated the pos and attitude prediction at the frame-end ***/
     double note = pcl_end_time > imu_end_time ? 1.0 : -1.0;
     dt = note * (pcl_end_time - imu_end_time);
-    kf_state.predict(dt, Q_, in);
+    preintegration_.Integrate(acc_avr, angvel_avr, dt, Q_);
+
+    /*** propagate the covariance once for the whole frame ***/
+    preintegration_.Apply(kf_state);
 
     imu_state = kf_state.get_x();
     last_imu_ = meas.imu_.back();
@@ -284,13 +272,14 @@ void ImuProcess::UndistortPcl(const common::MeasureGroup &meas, esekfom::esekf<s
     }
 }
 
-void ImuProcess::Process(const common::MeasureGroup &meas, esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
-                         PointCloudType::Ptr cur_pcl_un_) {
+inline void ImuProcess::Process(const common::MeasureGroup &meas,
+                                esekfom::esekf<state_ikfom, 12, input_ikfom> &kf_state,
+                                PointCloudType::Ptr cur_pcl_un_) {
     if (meas.imu_.empty()) {
         return;
     }
 
-    ROS_ASSERT(meas.lidar_ != nullptr);
+    CHECK(meas.lidar_ != nullptr);
 
     if (imu_need_init_) {
         /// The very first lidar frame
@@ -308,13 +297,12 @@ void ImuProcess::Process(const common::MeasureGroup &meas, esekfom::esekf<state_
             cov_acc_ = cov_acc_scale_;
             cov_gyr_ = cov_gyr_scale_;
             LOG(INFO) << "IMU Initial Done";
-            fout_imu_.open(common::DEBUG_FILE_DIR("imu_.txt"), std::ios::out);
         }
 
         return;
     }
 
-    Timer::Evaluate([&, this]() { UndistortPcl(meas, kf_state, *cur_pcl_un_); }, "Undistort Pcl");
+    timer_.Evaluate([&, this]() { UndistortPcl(meas, kf_state, *cur_pcl_un_); }, "Undistort Pcl");
 }
 }  // namespace faster_lio
 
@@ -5,6 +5,8 @@
 #ifndef FASTER_LIO_EIGEN_TYPES_H
 #define FASTER_LIO_EIGEN_TYPES_H
 
+#include <cstdint>
+
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
@@ -62,17 +64,27 @@ inline bool less_vec<3>::operator()(const Eigen::Matrix<int, 3, 1>& v1, const Ei
     return v1[0] < v2[0] || (v1[0] == v2[0] && v1[1] < v2[1]) && (v1[0] == v2[0] && v1[1] == v2[1] && v1[2] < v2[2]);
 }
 
-/// vec 2 hash
-/// @see Optimized Spatial Hashing for Collision Detection of Deformable Objects, Matthias Teschner et. al., VMV 2003
+/// splitmix64 finalizer, every bit of the key reaches every bit of the hash
+inline uint64_t MixKey(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/// vec 2 hash, both coordinates packed into 32 bits each
 template <>
 inline size_t hash_vec<2>::operator()(const Eigen::Matrix<int, 2, 1>& v) const {
-    return size_t(((v[0]) * 73856093) ^ ((v[1]) * 471943)) % 10000000;
+    return MixKey((uint64_t(uint32_t(v[0])) << 32) | uint32_t(v[1]));
 }
 
-/// vec 3 hash
+/// vec 3 hash, the low 21 bits of each coordinate packed into one key, unique within +-2^20 grids
 template <>
 inline size_t hash_vec<3>::operator()(const Eigen::Matrix<int, 3, 1>& v) const {
-    return size_t(((v[0]) * 73856093) ^ ((v[1]) * 471943) ^ ((v[2]) * 83492791)) % 10000000;
+    constexpr uint64_t mask = (1ULL << 21) - 1;
+    return MixKey(((uint64_t(v[0]) & mask) << 42) | ((uint64_t(v[1]) & mask) << 21) | (uint64_t(v[2]) & mask));
 }
 
 constexpr auto less_vec2i = [](const Vec2i& v1, const Vec2i& v2) {
@@ -7,7 +7,9 @@
 
 #include <glog/logging.h>
 #include <algorithm>
+#include <array>
 #include <list>
+#include <memory>
 #include <numeric>
 #include <thread>
 
@@ -16,31 +18,66 @@
 
 namespace faster_lio {
 
+/// offsets of the nearby grids, each nearby range is a prefix: the center, 6 faces, 12 edges and 8 corners
+constexpr int NEARBY_OFFSETS[27][3] = {
+    {0, 0, 0},   {-1, 0, 0},  {1, 0, 0},   {0, 1, 0},    {0, -1, 0},  {0, 0, -1},  {0, 0, 1},
+    {1, 1, 0},   {-1, 1, 0},  {1, -1, 0},  {-1, -1, 0},  {1, 0, 1},   {-1, 0, 1},  {1, 0, -1},
+    {-1, 0, -1}, {0, 1, 1},   {0, -1, 1},  {0, 1, -1},   {0, -1, -1}, {1, 1, 1},   {-1, 1, 1},
+    {1, -1, 1},  {1, 1, -1},  {-1, -1, 1}, {-1, 1, -1},  {1, -1, -1}, {-1, -1, -1}};
+
+/// NEARBY_OFFSETS[NEARBY_OPPOSITE[i]] is -NEARBY_OFFSETS[i]
+constexpr std::array<int, 27> NEARBY_OPPOSITE = [] {
+    std::array<int, 27> opposite{};
+    for (int i = 0; i < 27; ++i) {
+        for (int j = 0; j < 27; ++j) {
+            if (NEARBY_OFFSETS[j][0] == -NEARBY_OFFSETS[i][0] && NEARBY_OFFSETS[j][1] == -NEARBY_OFFSETS[i][1] &&
+                NEARBY_OFFSETS[j][2] == -NEARBY_OFFSETS[i][2]) {
+                opposite[i] = j;
+            }
+        }
+    }
+    return opposite;
+}();
+
 enum class IVoxNodeType {
-    DEFAULT,  // linear ivox
-    PHC,      // phc ivox
+    DEFAULT,    // linear ivox
+    PHC,        // phc ivox
+    QUANTIZED,  // linear ivox with 16-bit points relative to the grid center
 };
 
 /// traits for NodeType
-template <IVoxNodeType node_type, typename PointT, int dim>
+template <IVoxNodeType node_type, typename PointT, int dim, typename StoreT>
 struct IVoxNodeTypeTraits {};
 
-template <typename PointT, int dim>
-struct IVoxNodeTypeTraits<IVoxNodeType::DEFAULT, PointT, dim> {
-    using NodeType = IVoxNode<PointT, dim>;
+template <typename PointT, int dim, typename StoreT>
+struct IVoxNodeTypeTraits<IVoxNodeType::DEFAULT, PointT, dim, StoreT> {
+    using NodeType = IVoxNode<PointT, dim, StoreT>;
 };
 
-template <typename PointT, int dim>
-struct IVoxNodeTypeTraits<IVoxNodeType::PHC, PointT, dim> {
+/// phc nodes keep the centroids of PointT, the store type is not used
+template <typename PointT, int dim, typename StoreT>
+struct IVoxNodeTypeTraits<IVoxNodeType::PHC, PointT, dim, StoreT> {
     using NodeType = IVoxNodePhc<PointT, dim>;
 };
 
-template <int dim = 3, IVoxNodeType node_type = IVoxNodeType::DEFAULT, typename PointType = pcl::PointXYZ>
+/// quantized nodes keep their own encoding, the store type is not used
+template <typename PointT, int dim, typename StoreT>
+struct IVoxNodeTypeTraits<IVoxNodeType::QUANTIZED, PointT, dim, StoreT> {
+    using NodeType = IVoxNodeQuantized<PointT, dim>;
+};
+
+/**
+ * incremental voxel map
+ * PointType is the type of the inserted and the returned points, StoreType the type the points are kept in, e.g. a
+ * compact MapPointXYZ. The points are converted when they are inserted and when they are returned.
+ */
+template <int dim = 3, IVoxNodeType node_type = IVoxNodeType::DEFAULT, typename PointType = pcl::PointXYZ,
+          typename StoreType = PointType>
 class IVox {
    public:
     using KeyType = Eigen::Matrix<int, dim, 1>;
     using PtType = Eigen::Matrix<float, dim, 1>;
-    using NodeType = typename IVoxNodeTypeTraits<node_type, PointType, dim>::NodeType;
+    using NodeType = typename IVoxNodeTypeTraits<node_type, PointType, dim, StoreType>::NodeType;
     using PointVector = std::vector<PointType, Eigen::aligned_allocator<PointType>>;
     using DistPoint = typename NodeType::DistPoint;
 
@@ -56,6 +93,9 @@ class IVox {
         float inv_resolution_ = 10.0;                   // inverse resolution
         NearbyType nearby_type_ = NearbyType::NEARBY6;  // nearby range
         std::size_t capacity_ = 1000000;                // capacity
+        std::size_t expected_grids_ = 0;                // grids the hash map is sized for, 0 to let it grow
+        std::size_t max_points_per_grid_ = 0;           // points kept in one grid, 0 for unlimited
+        bool keep_distribution_ = false;                // keep the mean and covariance of each grid
     };
 
     /**
@@ -65,67 +105,124 @@ class IVox {
     explicit IVox(Options options) : options_(options) {
         options_.inv_resolution_ = 1.0 / options_.resolution_;
         GenerateNearbyGrids();
+
+        if (options_.expected_grids_ > 0) {
+            grids_map_.reserve(std::min(options_.expected_grids_, options_.capacity_));
+        }
     }
 
     /**
-     * clear eveything
+     * clear all grids, the nearby offsets and the buckets of the hash map are kept
      */
     inline void Reset() {
         grids_cache_.clear();
         grids_map_.clear();
-        nearby_grids_.clear();
+        num_points_ = 0;
+        point_bytes_ = 0;
+    }
+
+    /// change the nearby range, the grids are kept and linked again
+    void SetNearbyType(NearbyType nearby_type) {
+        options_.nearby_type_ = nearby_type;
+        GenerateNearbyGrids();
+        LinkAllGrids();
     }
     /**
-     * add points
+     * add points, the hash map grows before the first of them if they may not fit
      * @param points_to_add
      */
     void AddPoints(const PointVector& points_to_add);
 
+    /// add a single point
+    void AddPoint(const PointType& pt);
+
     /// get nn
     bool GetClosestPoint(const PointType& pt, PointType& closest_pt);
 
     /// get nn with condition
     bool GetClosestPoint(const PointType& pt, PointVector& closest_pt, int max_num = 5, double max_range = 5.0);
 
+    /// get nn with condition into closest_pt[0, max_num), the nearest one first, return the number of points found
+    int GetClosestPoint(const PointType& pt, PointType* closest_pt, int max_num = 5, double max_range = 5.0);
+
     /// get nn in cloud
     bool GetClosestPoint(const PointVector& cloud, PointVector& closest_cloud);
 
+    /// get the distribution of the grid containing pt, false if the grid has less than min_num points
+    /// or the distributions are not kept
+    bool GetDistribution(const PointType& pt, PtType& mean, Eigen::Matrix<float, dim, dim>& cov, int min_num = 5) const;
+
     /// get number of points
     size_t NumPoints() const;
 
     /// get number of valid grids
     size_t NumValidGrids() const;
 
+    /// heap bytes of the grid index, i.e. the hash map and the lru list with the nodes, without their points
+    size_t VoxelBytes() const;
+
+    /// heap bytes of the points in all grids
+    size_t PointBytes() const { return point_bytes_; }
+
     /// get statistics of the points
     std::vector<float> StatGridPoints() const;
 
    private:
+    /// a grid in the lru cache, with links to the existing grids in its nearby range
+    struct Grid {
+        Grid(const KeyType& key, NodeType&& node) : key_(key), node_(std::move(node)) {}
+
+        KeyType key_;
+        NodeType node_;
+        std::vector<Grid*> nearby_;  // nearby_[i] is the grid at key_ + NEARBY_OFFSETS[i], nullptr if not existing
+        std::unique_ptr<IVoxNodeDistribution<dim>> distribution_;  // all inserted points, only if keep_distribution_
+    };
+
+    using NearbyKeys = Eigen::Matrix<int, 27, dim>;  // a key per row, the coordinates of all keys are contiguous
+
     /// generate the nearby grids according to the given options
     void GenerateNearbyGrids();
 
+    /// keys of all 27 grids around key, computed with a vectorized add per axis
+    static NearbyKeys GetNearbyKeys(const KeyType& key);
+
+    /// link a new grid with its existing nearby grids, in both directions
+    void LinkGrid(Grid& grid);
+
+    /// remove the links of the other grids to a grid before it is evicted
+    void UnlinkGrid(Grid& grid);
+
+    /// link all grids again, after the nearby range has changed
+    void LinkAllGrids();
+
+    /// call func on every existing grid in the nearby range of key, dispatched to the nearby range of the options
+    template <typename Func>
+    void ForEachNearbyGrid(const KeyType& key, Func&& func);
+
+    /// call func on every existing grid in the first num nearby grids, one hash lookup if the grid of key exists
+    template <int num, typename Func>
+    void ForEachNearbyGrid(const KeyType& key, Func&& func);
+
     /// position to grid
     KeyType Pos2Grid(const PtType& pt) const;
 
     Options options_;
-    std::unordered_map<KeyType, typename std::list<std::pair<KeyType, NodeType>>::iterator, hash_vec<dim>>
-        grids_map_;                                        // voxel hash map
-    std::list<std::pair<KeyType, NodeType>> grids_cache_;  // voxel cache
-    std::vector<KeyType> nearby_grids_;                    // nearbys
+    std::unordered_map<KeyType, typename std::list<Grid>::iterator, hash_vec<dim>> grids_map_;  // voxel hash map
+    std::list<Grid> grids_cache_;                                                                 // voxel cache
+    int nearby_num_ = 7;           // nearby grids in the range, a prefix of NEARBY_OFFSETS
+    std::size_t num_points_ = 0;   // points in all grids
+    std::size_t point_bytes_ = 0;  // PointBytes of all grids
 };
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-bool IVox<dim, node_type, PointType>::GetClosestPoint(const PointType& pt, PointType& closest_pt) {
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+bool IVox<dim, node_type, PointType, StoreType>::GetClosestPoint(const PointType& pt, PointType& closest_pt) {
     std::vector<DistPoint> candidates;
     auto key = Pos2Grid(ToEigen<float, dim>(pt));
-    std::for_each(nearby_grids_.begin(), nearby_grids_.end(), [&key, &candidates, &pt, this](const KeyType& delta) {
-        auto dkey = key + delta;
-        auto iter = grids_map_.find(dkey);
-        if (iter != grids_map_.end()) {
-            DistPoint dist_point;
-            bool found = iter->second->second.NNPoint(pt, dist_point);
-            if (found) {
-                candidates.emplace_back(dist_point);
-            }
+    ForEachNearbyGrid(key, [&candidates, &pt](Grid& grid) {
+        DistPoint dist_point;
+        bool found = grid.node_.NNPoint(pt, dist_point);
+        if (found) {
+            candidates.emplace_back(dist_point);
         }
     });
 
@@ -138,11 +235,21 @@ bool IVox<dim, node_type, PointType>::GetClosestPoint(const PointType& pt, Point
     return true;
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-bool IVox<dim, node_type, PointType>::GetClosestPoint(const PointType& pt, PointVector& closest_pt, int max_num,
-                                                      double max_range) {
-    std::vector<DistPoint> candidates;
-    candidates.reserve(max_num * nearby_grids_.size());
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+bool IVox<dim, node_type, PointType, StoreType>::GetClosestPoint(const PointType& pt, PointVector& closest_pt,
+                                                                 int max_num, double max_range) {
+    closest_pt.resize(max_num);
+    closest_pt.resize(GetClosestPoint(pt, closest_pt.data(), max_num, max_range));
+    return closest_pt.empty() == false;
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+int IVox<dim, node_type, PointType, StoreType>::GetClosestPoint(const PointType& pt, PointType* closest_pt,
+                                                                int max_num, double max_range) {
+    // reused by every query of this thread, no allocation once it has grown
+    static thread_local std::vector<DistPoint> candidates;
+    candidates.clear();
+    candidates.reserve(max_num * nearby_num_);
 
     auto key = Pos2Grid(ToEigen<float, dim>(pt));
 
@@ -155,24 +262,20 @@ bool IVox<dim, node_type, PointType>::GetClosestPoint(const PointType& pt, Point
     }
 #endif
 
-    for (const KeyType& delta : nearby_grids_) {
-        auto dkey = key + delta;
-        auto iter = grids_map_.find(dkey);
-        if (iter != grids_map_.end()) {
+    ForEachNearbyGrid(key, [&](Grid& grid) {
 #ifdef INNER_TIMER
-            auto t1 = std::chrono::high_resolution_clock::now();
+        auto t1 = std::chrono::high_resolution_clock::now();
 #endif
-            auto tmp = iter->second->second.KNNPointByCondition(candidates, pt, max_num, max_range);
+        auto tmp = grid.node_.KNNPointByCondition(candidates, pt, max_num, max_range);
 #ifdef INNER_TIMER
-            auto t2 = std::chrono::high_resolution_clock::now();
-            auto knn = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
-            stats["knn"].emplace_back(knn);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto knn = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        stats["knn"].emplace_back(knn);
 #endif
-        }
-    }
+    });
 
     if (candidates.empty()) {
-        return false;
+        return 0;
     }
 
 #ifdef INNER_TIMER
@@ -205,82 +308,232 @@ bool IVox<dim, node_type, PointType>::GetClosestPoint(const PointType& pt, Point
     }
 #endif
 
-    closest_pt.clear();
-    for (auto& it : candidates) {
-        closest_pt.emplace_back(it.Get());
+    for (std::size_t k = 0; k < candidates.size(); ++k) {
+        closest_pt[k] = candidates[k].Get();
     }
-    return closest_pt.empty() == false;
+    return candidates.size();
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-size_t IVox<dim, node_type, PointType>::NumValidGrids() const {
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+bool IVox<dim, node_type, PointType, StoreType>::GetDistribution(const PointType& pt, PtType& mean,
+                                                                 Eigen::Matrix<float, dim, dim>& cov,
+                                                                 int min_num) const {
+    auto iter = grids_map_.find(Pos2Grid(ToEigen<float, dim>(pt)));
+    if (iter == grids_map_.end()) {
+        return false;
+    }
+
+    if (iter->second->distribution_ == nullptr) {
+        return false;
+    }
+
+    const auto& distribution = *iter->second->distribution_;
+    if (distribution.num_ < std::max(min_num, 2)) {
+        return false;
+    }
+
+    mean = distribution.mean_;
+    cov = distribution.Cov();
+    return true;
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+size_t IVox<dim, node_type, PointType, StoreType>::NumPoints() const {
+    return num_points_;
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+size_t IVox<dim, node_type, PointType, StoreType>::NumValidGrids() const {
     return grids_map_.size();
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-void IVox<dim, node_type, PointType>::GenerateNearbyGrids() {
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+size_t IVox<dim, node_type, PointType, StoreType>::VoxelBytes() const {
+    // a list node and a hash node per grid, both with two pointers of overhead, the links and the bucket array
+    const size_t grid_bytes = sizeof(typename decltype(grids_cache_)::value_type) +
+                              sizeof(typename decltype(grids_map_)::value_type) + 4 * sizeof(void*) +
+                              nearby_num_ * sizeof(Grid*) +
+                              (options_.keep_distribution_ ? sizeof(IVoxNodeDistribution<dim>) : 0);
+    return grids_map_.size() * grid_bytes + grids_map_.bucket_count() * sizeof(void*);
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::GenerateNearbyGrids() {
     if (options_.nearby_type_ == NearbyType::CENTER) {
-        nearby_grids_.emplace_back(KeyType::Zero());
+        nearby_num_ = 1;
     } else if (options_.nearby_type_ == NearbyType::NEARBY6) {
-        nearby_grids_ = {KeyType(0, 0, 0),  KeyType(-1, 0, 0), KeyType(1, 0, 0), KeyType(0, 1, 0),
-                         KeyType(0, -1, 0), KeyType(0, 0, -1), KeyType(0, 0, 1)};
+        nearby_num_ = 7;
     } else if (options_.nearby_type_ == NearbyType::NEARBY18) {
-        nearby_grids_ = {KeyType(0, 0, 0),  KeyType(-1, 0, 0), KeyType(1, 0, 0),   KeyType(0, 1, 0),
-                         KeyType(0, -1, 0), KeyType(0, 0, -1), KeyType(0, 0, 1),   KeyType(1, 1, 0),
-                         KeyType(-1, 1, 0), KeyType(1, -1, 0), KeyType(-1, -1, 0), KeyType(1, 0, 1),
-                         KeyType(-1, 0, 1), KeyType(1, 0, -1), KeyType(-1, 0, -1), KeyType(0, 1, 1),
-                         KeyType(0, -1, 1), KeyType(0, 1, -1), KeyType(0, -1, -1)};
+        nearby_num_ = 19;
     } else if (options_.nearby_type_ == NearbyType::NEARBY26) {
-        nearby_grids_ = {KeyType(0, 0, 0),   KeyType(-1, 0, 0),  KeyType(1, 0, 0),   KeyType(0, 1, 0),
-                         KeyType(0, -1, 0),  KeyType(0, 0, -1),  KeyType(0, 0, 1),   KeyType(1, 1, 0),
-                         KeyType(-1, 1, 0),  KeyType(1, -1, 0),  KeyType(-1, -1, 0), KeyType(1, 0, 1),
-                         KeyType(-1, 0, 1),  KeyType(1, 0, -1),  KeyType(-1, 0, -1), KeyType(0, 1, 1),
-                         KeyType(0, -1, 1),  KeyType(0, 1, -1),  KeyType(0, -1, -1), KeyType(1, 1, 1),
-                         KeyType(-1, 1, 1),  KeyType(1, -1, 1),  KeyType(1, 1, -1),  KeyType(-1, -1, 1),
-                         KeyType(-1, 1, -1), KeyType(1, -1, -1), KeyType(-1, -1, -1)};
+        nearby_num_ = 27;
     } else {
         LOG(ERROR) << "Unknown nearby_type!";
     }
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-void IVox<dim, node_type, PointType>::AddPoints(const PointVector& points_to_add) {
-    std::for_each(points_to_add.begin(), points_to_add.end(), [this](const auto& pt) {
-        auto key = Pos2Grid(ToEigen<float, dim>(pt));
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+typename IVox<dim, node_type, PointType, StoreType>::NearbyKeys
+IVox<dim, node_type, PointType, StoreType>::GetNearbyKeys(const KeyType& key) {
+    static const NearbyKeys offsets = [] {
+        NearbyKeys offsets;
+        for (int i = 0; i < 27; ++i) {
+            offsets.row(i) = Eigen::Map<const KeyType>(NEARBY_OFFSETS[i]).transpose();
+        }
+        return offsets;
+    }();
+    return offsets.rowwise() + key.transpose();
+}
 
-        auto iter = grids_map_.find(key);
-        if (iter == grids_map_.end()) {
-            PointType center;
-            center.getVector3fMap() = key.template cast<float>() * options_.resolution_;
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::LinkGrid(Grid& grid) {
+    grid.nearby_.assign(nearby_num_, nullptr);
+    grid.nearby_[0] = &grid;
+    const NearbyKeys keys = GetNearbyKeys(grid.key_);
+    for (int i = 1; i < nearby_num_; ++i) {
+        auto iter = grids_map_.find(keys.row(i).transpose());
+        if (iter != grids_map_.end()) {
+            grid.nearby_[i] = &*iter->second;
+            iter->second->nearby_[NEARBY_OPPOSITE[i]] = &grid;
+        }
+    }
+}
 
-            grids_cache_.push_front({key, NodeType(center, options_.resolution_)});
-            grids_map_.insert({key, grids_cache_.begin()});
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::UnlinkGrid(Grid& grid) {
+    for (std::size_t i = 1; i < grid.nearby_.size(); ++i) {
+        if (grid.nearby_[i] != nullptr) {
+            grid.nearby_[i]->nearby_[NEARBY_OPPOSITE[i]] = nullptr;
+        }
+    }
+}
 
-            grids_cache_.front().second.InsertPoint(pt);
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::LinkAllGrids() {
+    for (auto& grid : grids_cache_) {
+        grid.nearby_.assign(nearby_num_, nullptr);
+    }
+    for (auto& grid : grids_cache_) {
+        LinkGrid(grid);
+    }
+}
 
-            if (grids_map_.size() >= options_.capacity_) {
-                grids_map_.erase(grids_cache_.back().first);
-                grids_cache_.pop_back();
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+template <typename Func>
+void IVox<dim, node_type, PointType, StoreType>::ForEachNearbyGrid(const KeyType& key, Func&& func) {
+    switch (nearby_num_) {
+        case 1:
+            ForEachNearbyGrid<1>(key, func);
+            break;
+        case 7:
+            ForEachNearbyGrid<7>(key, func);
+            break;
+        case 19:
+            ForEachNearbyGrid<19>(key, func);
+            break;
+        default:
+            ForEachNearbyGrid<27>(key, func);
+            break;
+    }
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+template <int num, typename Func>
+void IVox<dim, node_type, PointType, StoreType>::ForEachNearbyGrid(const KeyType& key, Func&& func) {
+    auto iter = grids_map_.find(key);
+    if (iter != grids_map_.end()) {
+        Grid* const* nearby = iter->second->nearby_.data();
+
+        // request all nearby nodes before the first one is searched
+        for (int i = 1; i < num; ++i) {
+            if (nearby[i] != nullptr) {
+                __builtin_prefetch(&nearby[i]->node_);
             }
-        } else {
-            iter->second->second.InsertPoint(pt);
-            grids_cache_.splice(grids_cache_.begin(), grids_cache_, iter->second);
-            grids_map_[key] = grids_cache_.begin();
         }
-    });
+        for (int i = 0; i < num; ++i) {
+            if (nearby[i] != nullptr) {
+                func(*nearby[i]);
+            }
+        }
+        return;
+    }
+
+    // no grid at the center, look up the others one by one
+    const NearbyKeys keys = GetNearbyKeys(key);
+    for (int i = 1; i < num; ++i) {
+        iter = grids_map_.find(keys.row(i).transpose());
+        if (iter != grids_map_.end()) {
+            func(*iter->second);
+        }
+    }
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::AddPoints(const PointVector& points_to_add) {
+    // at most one new grid per point, doubling keeps the rehashes as rare as the map's own growth
+    const std::size_t max_grids = grids_map_.size() + points_to_add.size();
+    if (max_grids > grids_map_.max_load_factor() * grids_map_.bucket_count()) {
+        grids_map_.reserve(std::min(std::max(2 * grids_map_.size(), max_grids), options_.capacity_));
+    }
+    std::for_each(points_to_add.begin(), points_to_add.end(), [this](const auto& pt) { AddPoint(pt); });
+}
+
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+void IVox<dim, node_type, PointType, StoreType>::AddPoint(const PointType& pt) {
+    auto key = Pos2Grid(ToEigen<float, dim>(pt));
+
+    auto iter = grids_map_.find(key);
+    if (iter == grids_map_.end()) {
+        PointType center;
+        center.getVector3fMap() = key.template cast<float>() * options_.resolution_;
+
+        grids_cache_.emplace_front(key, NodeType(center, options_.resolution_));
+        grids_map_.insert({key, grids_cache_.begin()});
+        LinkGrid(grids_cache_.front());
+        if (options_.keep_distribution_) {
+            grids_cache_.front().distribution_ = std::make_unique<IVoxNodeDistribution<dim>>();
+            grids_cache_.front().distribution_->AddPoint(ToEigen<float, dim>(pt));
+        }
+
+        grids_cache_.front().node_.InsertPoint(pt);
+        num_points_ += grids_cache_.front().node_.Size();
+        point_bytes_ += grids_cache_.front().node_.PointBytes();
+
+        if (grids_map_.size() >= options_.capacity_) {
+            num_points_ -= grids_cache_.back().node_.Size();
+            point_bytes_ -= grids_cache_.back().node_.PointBytes();
+            UnlinkGrid(grids_cache_.back());
+            grids_map_.erase(grids_cache_.back().key_);
+            grids_cache_.pop_back();
+        }
+    } else {
+        auto& node = iter->second->node_;
+        if (options_.max_points_per_grid_ == 0 || node.Size() < options_.max_points_per_grid_) {
+            // a phc node may merge the point into an existing cube
+            const std::size_t size = node.Size(), bytes = node.PointBytes();
+            node.InsertPoint(pt);
+            if (iter->second->distribution_ != nullptr) {
+                iter->second->distribution_->AddPoint(ToEigen<float, dim>(pt));
+            }
+            num_points_ += node.Size() - size;
+            point_bytes_ += node.PointBytes() - bytes;
+        }
+        grids_cache_.splice(grids_cache_.begin(), grids_cache_, iter->second);
+        grids_map_[key] = grids_cache_.begin();
+    }
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-Eigen::Matrix<int, dim, 1> IVox<dim, node_type, PointType>::Pos2Grid(const IVox::PtType& pt) const {
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+Eigen::Matrix<int, dim, 1> IVox<dim, node_type, PointType, StoreType>::Pos2Grid(const IVox::PtType& pt) const {
     return (pt * options_.inv_resolution_).array().round().template cast<int>();
 }
 
-template <int dim, IVoxNodeType node_type, typename PointType>
-std::vector<float> IVox<dim, node_type, PointType>::StatGridPoints() const {
+template <int dim, IVoxNodeType node_type, typename PointType, typename StoreType>
+std::vector<float> IVox<dim, node_type, PointType, StoreType>::StatGridPoints() const {
     int num = grids_cache_.size(), valid_num = 0, max = 0, min = 100000000;
     int sum = 0, sum_square = 0;
     for (auto& it : grids_cache_) {
-        int s = it.second.Size();
+        int s = it.node_.Size();
         valid_num += s > 0;
         max = s > max ? s : max;
         min = s < min ? s : min;
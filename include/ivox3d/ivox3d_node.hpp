@@ -2,15 +2,19 @@
 #include <algorithm>
 #include <cmath>
 #include <list>
+#include <type_traits>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "hilbert.hpp"
 
 namespace faster_lio {
 
-// squared distance of two pcl points
-template <typename PointT>
-inline double distance2(const PointT& pt1, const PointT& pt2) {
+// squared distance of two points, pcl or map points
+template <typename PointT1, typename PointT2>
+inline double distance2(const PointT1& pt1, const PointT2& pt2) {
     Eigen::Vector3f d = pt1.getVector3fMap() - pt2.getVector3fMap();
     return d.squaredNorm();
 }
@@ -36,7 +40,75 @@ inline Eigen::Matrix<float, 3, 1> ToEigen<float, 3, pcl::PointXYZINormal>(const
     return pt.getVector3fMap();
 }
 
-template <typename PointT, int dim = 3>
+/// compact point kept in the map, the position only (12 bytes instead of 48 for pcl::PointXYZINormal)
+struct MapPointXYZ {
+    float x = 0, y = 0, z = 0;
+
+    inline Eigen::Map<Eigen::Vector3f> getVector3fMap() { return Eigen::Map<Eigen::Vector3f>(&x); }
+    inline Eigen::Map<const Eigen::Vector3f> getVector3fMap() const { return Eigen::Map<const Eigen::Vector3f>(&x); }
+};
+
+/// compact point kept in the map, the position and the intensity clamped to [0, 255] (16 bytes)
+struct MapPointXYZI {
+    float x = 0, y = 0, z = 0;
+    uint8_t intensity = 0;
+
+    inline Eigen::Map<Eigen::Vector3f> getVector3fMap() { return Eigen::Map<Eigen::Vector3f>(&x); }
+    inline Eigen::Map<const Eigen::Vector3f> getVector3fMap() const { return Eigen::Map<const Eigen::Vector3f>(&x); }
+};
+
+// convert an inserted point to the type kept in the map
+template <typename StoreT, typename PointT>
+inline StoreT ToMapPoint(const PointT& pt) {
+    if constexpr (std::is_same_v<StoreT, PointT>) {
+        return pt;
+    } else {
+        StoreT store;
+        store.getVector3fMap() = pt.getVector3fMap();
+        if constexpr (std::is_same_v<StoreT, MapPointXYZI>) {
+            store.intensity = uint8_t(std::min(std::max(pt.intensity, 0.0f), 255.0f));
+        }
+        return store;
+    }
+}
+
+// convert a point kept in the map back to the returned type, fields not kept are default
+template <typename PointT, typename StoreT>
+inline PointT FromMapPoint(const StoreT& store) {
+    if constexpr (std::is_same_v<StoreT, PointT>) {
+        return store;
+    } else {
+        PointT pt;
+        pt.getVector3fMap() = store.getVector3fMap();
+        if constexpr (std::is_same_v<StoreT, MapPointXYZI>) {
+            pt.intensity = store.intensity;
+        }
+        return pt;
+    }
+}
+
+/// mean and covariance of the points in a grid, updated incrementally (Welford)
+template <int dim = 3>
+struct IVoxNodeDistribution {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    int num_ = 0;
+    Eigen::Matrix<float, dim, 1> mean_ = Eigen::Matrix<float, dim, 1>::Zero();
+    Eigen::Matrix<float, dim, dim> m2_ = Eigen::Matrix<float, dim, dim>::Zero();  // sum of squared deviations
+
+    inline void AddPoint(const Eigen::Matrix<float, dim, 1>& pt) {
+        num_++;
+        const Eigen::Matrix<float, dim, 1> d = pt - mean_;
+        mean_ += d / num_;
+        m2_ += d * (pt - mean_).transpose();
+    }
+
+    /// sample covariance, valid if num_ > 1
+    inline Eigen::Matrix<float, dim, dim> Cov() const { return m2_ / (num_ - 1); }
+};
+
+/// linear node, the points are kept as StoreT
+template <typename PointT, int dim = 3, typename StoreT = PointT>
 class IVoxNode {
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
@@ -52,13 +124,16 @@ class IVoxNode {
 
     inline std::size_t Size() const;
 
+    /// heap bytes of the stored points
+    inline std::size_t PointBytes() const { return points_.capacity() * sizeof(StoreT); }
+
     inline PointT GetPoint(const std::size_t idx) const;
 
     int KNNPointByCondition(std::vector<DistPoint>& dis_points, const PointT& point, const int& K,
                             const double& max_range);
 
    private:
-    std::vector<PointT> points_;
+    std::vector<StoreT> points_;
 };
 
 template <typename PointT, int dim = 3>
@@ -80,6 +155,9 @@ class IVoxNodePhc {
 
     inline std::size_t Size() const;
 
+    /// heap bytes of the stored cubes
+    inline std::size_t PointBytes() const { return phc_cubes_.capacity() * sizeof(PhcCube); }
+
     PointT GetPoint(const std::size_t idx) const;
 
     bool NNPoint(const PointT& cur_pt, DistPoint& dist_point) const;
@@ -101,8 +179,54 @@ class IVoxNodePhc {
     Eigen::Matrix<float, dim, 1> min_cube_;
 };
 
-template <typename PointT, int dim>
-struct IVoxNode<PointT, dim>::DistPoint {
+/// node keeping the points as 16-bit offsets from its center, for a compact map
+/// a point takes 6 bytes, the quantization error is side_length / 131068 per axis (4 um for 0.5 m grids)
+template <typename PointT, int dim = 3>
+class IVoxNodeQuantized {
+   public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    struct DistPoint;
+
+    static constexpr int BLOCK_SIZE = 4;  // points per block, decoded in one vector op per axis
+
+    IVoxNodeQuantized() = default;
+    IVoxNodeQuantized(const PointT& center, const float& side_length);
+
+    void InsertPoint(const PointT& pt);
+
+    inline bool Empty() const { return num_points_ == 0; }
+
+    inline std::size_t Size() const { return num_points_; }
+
+    /// heap bytes of the stored blocks
+    inline std::size_t PointBytes() const { return blocks_.capacity() * sizeof(Block); }
+
+    PointT GetPoint(const std::size_t idx) const;
+
+    int KNNPointByCondition(std::vector<DistPoint>& dis_points, const PointT& point, const int& K,
+                            const double& max_range);
+
+   private:
+    /// the offsets of BLOCK_SIZE points, one row per axis so that a block is decoded with a vector op per axis
+    struct Block {
+        int16_t offsets_[3][BLOCK_SIZE] = {};
+    };
+
+    /// squared distances of the points of block to query, both in quantization steps
+    /// @return  a bit per point closer than max_range2
+    static inline int BlockDistances(const Block& block, const Eigen::Vector3f& query, const float max_range2,
+                                     float* dist2);
+
+    std::vector<Block> blocks_;
+    Eigen::Vector3f center_ = Eigen::Vector3f::Zero();
+    float step_ = 0;      // length of one quantization step
+    float inv_step_ = 0;  // inverse of step_
+    std::size_t num_points_ = 0;
+};
+
+template <typename PointT, int dim, typename StoreT>
+struct IVoxNode<PointT, dim, StoreT>::DistPoint {
     double dist = 0;
     IVoxNode* node = nullptr;
     int idx = 0;
@@ -117,29 +241,29 @@ struct IVoxNode<PointT, dim>::DistPoint {
     inline bool operator<(const DistPoint& rhs) { return dist < rhs.dist; }
 };
 
-template <typename PointT, int dim>
-void IVoxNode<PointT, dim>::InsertPoint(const PointT& pt) {
-    points_.template emplace_back(pt);
+template <typename PointT, int dim, typename StoreT>
+void IVoxNode<PointT, dim, StoreT>::InsertPoint(const PointT& pt) {
+    points_.emplace_back(ToMapPoint<StoreT>(pt));
 }
 
-template <typename PointT, int dim>
-bool IVoxNode<PointT, dim>::Empty() const {
+template <typename PointT, int dim, typename StoreT>
+bool IVoxNode<PointT, dim, StoreT>::Empty() const {
     return points_.empty();
 }
 
-template <typename PointT, int dim>
-std::size_t IVoxNode<PointT, dim>::Size() const {
+template <typename PointT, int dim, typename StoreT>
+std::size_t IVoxNode<PointT, dim, StoreT>::Size() const {
     return points_.size();
 }
 
-template <typename PointT, int dim>
-PointT IVoxNode<PointT, dim>::GetPoint(const std::size_t idx) const {
-    return points_[idx];
+template <typename PointT, int dim, typename StoreT>
+PointT IVoxNode<PointT, dim, StoreT>::GetPoint(const std::size_t idx) const {
+    return FromMapPoint<PointT>(points_[idx]);
 }
 
-template <typename PointT, int dim>
-int IVoxNode<PointT, dim>::KNNPointByCondition(std::vector<DistPoint>& dis_points, const PointT& point, const int& K,
-                                               const double& max_range) {
+template <typename PointT, int dim, typename StoreT>
+int IVoxNode<PointT, dim, StoreT>::KNNPointByCondition(std::vector<DistPoint>& dis_points, const PointT& point,
+                                                       const int& K, const double& max_range) {
     std::size_t old_size = dis_points.size();
 // #define INNER_TIMER
 #ifdef INNER_TIMER
@@ -408,4 +532,117 @@ uint32_t IVoxNodePhc<PointT, dim>::CalculatePhcIndex(const PointT& pt) const {
     return idx;
 }
 
+template <typename PointT, int dim>
+struct IVoxNodeQuantized<PointT, dim>::DistPoint {
+    double dist = 0;
+    IVoxNodeQuantized* node = nullptr;
+    int idx = 0;
+
+    DistPoint() = default;
+    DistPoint(const double d, IVoxNodeQuantized* n, const int i) : dist(d), node(n), idx(i) {}
+
+    PointT Get() { return node->GetPoint(idx); }
+
+    inline bool operator()(const DistPoint& p1, const DistPoint& p2) { return p1.dist < p2.dist; }
+
+    inline bool operator<(const DistPoint& rhs) { return dist < rhs.dist; }
+};
+
+template <typename PointT, int dim>
+IVoxNodeQuantized<PointT, dim>::IVoxNodeQuantized(const PointT& center, const float& side_length)
+    : center_(center.getVector3fMap()) {
+    // the points of a grid are within half a side of its center, mapped to [-32767, 32767]
+    step_ = side_length / 65534.0f;
+    inv_step_ = 1.0f / step_;
+}
+
+template <typename PointT, int dim>
+void IVoxNodeQuantized<PointT, dim>::InsertPoint(const PointT& pt) {
+    if (num_points_ % BLOCK_SIZE == 0) {
+        blocks_.emplace_back();
+    }
+    const Eigen::Vector3f offset = (pt.getVector3fMap() - center_) * inv_step_;
+    for (int i = 0; i < 3; ++i) {
+        blocks_.back().offsets_[i][num_points_ % BLOCK_SIZE] =
+            int16_t(std::lround(std::min(std::max(offset[i], -32767.0f), 32767.0f)));
+    }
+    num_points_++;
+}
+
+template <typename PointT, int dim>
+PointT IVoxNodeQuantized<PointT, dim>::GetPoint(const std::size_t idx) const {
+    const Block& block = blocks_[idx / BLOCK_SIZE];
+    const int j = idx % BLOCK_SIZE;
+
+    PointT pt;
+    pt.getVector3fMap() =
+        center_ + step_ * Eigen::Vector3f(block.offsets_[0][j], block.offsets_[1][j], block.offsets_[2][j]);
+    return pt;
+}
+
+template <typename PointT, int dim>
+int IVoxNodeQuantized<PointT, dim>::BlockDistances(const Block& block, const Eigen::Vector3f& query,
+                                                   const float max_range2, float* dist2) {
+#if defined(__SSE2__)
+    static_assert(BLOCK_SIZE == 4 && sizeof(Block) == 24, "a row of a block is expected to fill half a register");
+    // the x and y rows in one load, z in the lower half of another
+    const __m128i xy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.offsets_[0]));
+    const __m128i z = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block.offsets_[2]));
+
+    // sign extend to 32 bits by moving each offset into the upper half of a lane, then convert
+    const __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(xy, xy), 16));
+    const __m128 y = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(xy, xy), 16));
+    const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(query[0]));
+    const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(query[1]));
+    const __m128 dz = _mm_sub_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(z, z), 16)), _mm_set1_ps(query[2]));
+    const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    _mm_storeu_ps(dist2, d2);
+    return _mm_movemask_ps(_mm_cmplt_ps(d2, _mm_set1_ps(max_range2)));
+#else
+    int mask = 0;
+    for (int j = 0; j < BLOCK_SIZE; ++j) {
+        const float dx = float(block.offsets_[0][j]) - query[0];
+        const float dy = float(block.offsets_[1][j]) - query[1];
+        const float dz = float(block.offsets_[2][j]) - query[2];
+        dist2[j] = dx * dx + dy * dy + dz * dz;
+        mask |= int(dist2[j] < max_range2) << j;
+    }
+    return mask;
+#endif
+}
+
+template <typename PointT, int dim>
+int IVoxNodeQuantized<PointT, dim>::KNNPointByCondition(std::vector<DistPoint>& dis_points, const PointT& point,
+                                                        const int& K, const double& max_range) {
+    std::size_t old_size = dis_points.size();
+
+    // the distances are computed in quantization steps, on the offsets without decoding them to positions
+    const Eigen::Vector3f query = (point.getVector3fMap() - center_) * inv_step_;
+    const float max_range2 = max_range * max_range * inv_step_ * inv_step_;
+    const double step2 = double(step_) * step_;
+
+    float dist2[BLOCK_SIZE];
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+        int mask = BlockDistances(blocks_[b], query, max_range2, dist2);
+        if (b + 1 == blocks_.size()) {
+            mask &= (1 << (num_points_ - b * BLOCK_SIZE)) - 1;  // the tail of the last block is not filled
+        }
+
+        // only the points within range are visited, one bit each
+        while (mask != 0) {
+            const int j = __builtin_ctz(mask);
+            mask &= mask - 1;
+            dis_points.emplace_back(DistPoint(dist2[j] * step2, this, b * BLOCK_SIZE + j));
+        }
+    }
+
+    // sort by distance
+    if (old_size + K < dis_points.size()) {
+        std::nth_element(dis_points.begin() + old_size, dis_points.begin() + old_size + K - 1, dis_points.end());
+        dis_points.resize(old_size + K);
+    }
+
+    return dis_points.size();
+}
+
 }  // namespace faster_lio
@@ -0,0 +1,117 @@
+#ifndef FASTER_LIO_IVOX3D_PYRAMID_H
+#define FASTER_LIO_IVOX3D_PYRAMID_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "ivox3d.h"
+
+namespace faster_lio {
+
+/**
+ * multi-resolution ivox
+ * level 0 is the normal (finest) ivox, the higher levels use larger grids and keep only a few points per grid.
+ * all levels are updated in one pass over the inserted points. Coarse levels have a wider convergence basin for the
+ * first IEKF iterations, the fine level is used once the pose is close.
+ */
+template <int dim = 3, IVoxNodeType node_type = IVoxNodeType::DEFAULT, typename PointType = pcl::PointXYZ,
+          typename StoreType = PointType>
+class IVoxPyramid {
+   public:
+    using IVoxType = IVox<dim, node_type, PointType, StoreType>;
+    using PointVector = typename IVoxType::PointVector;
+
+    /**
+     * constructor
+     * @param fine_options  options of the finest level
+     * @param coarse_resolutions  grid size of the coarse levels, empty for a single level
+     * @param coarse_grid_capacity  max points kept in one grid of the coarse levels
+     */
+    IVoxPyramid(const typename IVoxType::Options& fine_options, std::vector<float> coarse_resolutions,
+                std::size_t coarse_grid_capacity) {
+        levels_.emplace_back(std::make_shared<IVoxType>(fine_options));
+        resolutions_.emplace_back(fine_options.resolution_);
+
+        std::sort(coarse_resolutions.begin(), coarse_resolutions.end());
+        for (const float& res : coarse_resolutions) {
+            if (res <= resolutions_.back()) {
+                LOG(WARNING) << "ignore ivox pyramid level " << res << ", not coarser than " << resolutions_.back();
+                continue;
+            }
+            typename IVoxType::Options options = fine_options;
+            options.resolution_ = res;
+            options.max_points_per_grid_ = coarse_grid_capacity;
+            // a coarse level covers the same space with fewer grids
+            const float ratio = fine_options.resolution_ / res;
+            options.expected_grids_ = static_cast<std::size_t>(fine_options.expected_grids_ * ratio * ratio * ratio);
+            levels_.emplace_back(std::make_shared<IVoxType>(options));
+            resolutions_.emplace_back(res);
+        }
+    }
+
+    /// clear all levels
+    void Reset() {
+        for (auto& level : levels_) {
+            level->Reset();
+        }
+    }
+
+    /// add points to every level
+    void AddPoints(const PointVector& points_to_add) {
+        std::for_each(points_to_add.begin(), points_to_add.end(), [this](const auto& pt) {
+            for (auto& level : levels_) {
+                level->AddPoint(pt);
+            }
+        });
+    }
+
+    /// change the nearby range of every level
+    void SetNearbyType(typename IVoxType::NearbyType nearby_type) {
+        for (auto& level : levels_) {
+            level->SetNearbyType(nearby_type);
+        }
+    }
+
+    /// heap bytes of the grid index and of the points, summed over the levels
+    size_t VoxelBytes() const {
+        size_t bytes = 0;
+        for (const auto& level : levels_) {
+            bytes += level->VoxelBytes();
+        }
+        return bytes;
+    }
+    size_t PointBytes() const {
+        size_t bytes = 0;
+        for (const auto& level : levels_) {
+            bytes += level->PointBytes();
+        }
+        return bytes;
+    }
+
+    /// number of levels, including the finest one
+    int NumLevels() const { return levels_.size(); }
+
+    /// the ivox of a level, 0 is the finest
+    const std::shared_ptr<IVoxType>& Level(int level) const { return levels_[level]; }
+
+    /// grid size of a level
+    float Resolution(int level) const { return resolutions_[level]; }
+
+    /**
+     * level to match against at the given iteration, coarsest first and one level finer per iteration
+     * the IEKF calls the observation model max_iter + 1 times (iter 0 to max_iter) and the last call gives the
+     * posterior, so the level is capped to reach the finest one at the last call whatever the number of levels
+     */
+    int LevelAtIteration(int iter, int max_iter) const {
+        return std::max(0, std::min(NumLevels() - 1 - iter, max_iter - iter));
+    }
+
+   private:
+    std::vector<std::shared_ptr<IVoxType>> levels_;
+    std::vector<float> resolutions_;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_IVOX3D_PYRAMID_H
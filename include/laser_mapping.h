@@ -1,40 +1,51 @@
 #ifndef FASTER_LIO_LASER_MAPPING_H
 #define FASTER_LIO_LASER_MAPPING_H
 
+#include <nav_msgs/Odometry.h>
 #include <nav_msgs/Path.h>
-#include <pcl/filters/voxel_grid.h>
 #include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
 #include <sensor_msgs/PointCloud2.h>
-#include <condition_variable>
-#include <thread>
 
 #include <std_srvs/Empty.h>
-#include "common_lib.h"
-#include "imu_processing.hpp"
-#include "ivox3d/ivox3d.h"
-#include "options.h"
+#include "lio_core.h"
+#include "metrics.h"
 #include "pointcloud_preprocess.h"
 #include "ros/node_handle.h"
+#include "tf/transform_broadcaster.h"
 #include "tf/transform_listener.h"
 namespace faster_lio {
 
+/**
+ * ros adapter of the estimation core
+ * converts the ros messages into the inputs of LioCore and publishes its outputs
+ */
 class LaserMapping {
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
 
-#ifdef IVOX_NODE_TYPE_PHC
-    using IVoxType = IVox<3, IVoxNodeType::PHC, PointType>;
-#else
-    using IVoxType = IVox<3, IVoxNodeType::DEFAULT, PointType>;
-#endif
+    struct Options {
+        LioCore::Options core_;
+        PointCloudPreprocess::Options preprocess_;
+
+        bool path_pub_en_ = true;
+        bool scan_pub_en_ = false;
+        bool dense_pub_en_ = false;
+        bool scan_body_pub_en_ = false;
+        bool scan_effect_pub_en_ = false;
+        bool pcd_save_en_ = false;
+        int pcd_save_interval_ = -1;
+        bool path_save_en_ = false;
+        int metrics_port_ = 0;  // local http port of the live metrics, 0 for off
+        std::string trace_file_ = common::DEBUG_FILE_DIR("trace.json");  // timeline dump, see LioCore::GetTracer
+
+        std::string base_link_frame_ = "base_footprint_tug";
+        std::string lidar_frame_ = "main_sensor_lidar";
+        std::string global_frame_ = "world";
+    };
 
     LaserMapping();
-    ~LaserMapping() {
-        scan_down_body_ = nullptr;
-        scan_undistort_ = nullptr;
-        scan_down_world_ = nullptr;
-        LOG(INFO) << "laser mapping deconstruct";
-    }
+    ~LaserMapping() { LOG(INFO) << "laser mapping deconstruct"; }
 
     /// init with ros
     bool InitROS(const ros::NodeHandle &nh, const ros::NodeHandle &pnh);
@@ -42,20 +53,24 @@ class LaserMapping {
     /// init without ros
     bool InitWithoutROS(const std::string &config_yaml);
 
+    /// init with given options
+    bool Init(const Options &options);
+
     void Run();
     // services
     bool startLIO(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
     bool stopLIO(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+    /// re-read the runtime parameters from the param server, applied at the next frame
+    bool reloadParams(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
+    /// write the recorded timeline to the trace file
+    bool dumpTrace(std_srvs::Empty::Request &req, std_srvs::Empty::Response &res);
 
     // callbacks of lidar and imu
     void StandardPCLCallBack(const sensor_msgs::PointCloud2::ConstPtr &msg);
     void IMUCallBack(const sensor_msgs::Imu::ConstPtr &msg_in);
 
-    // sync lidar with imu
-    bool SyncPackages();
-
-    /// interface of mtk, customized obseravtion model
-    void ObsModel(state_ikfom &s, esekfom::dyn_share_datastruct<double> &ekfom_data);
+    /// the estimation core
+    std::shared_ptr<LioCore> Core() { return core_; }
 
     ////////////////////////////// debug save / show ////////////////////////////////////////////////////////////////
     void PublishPath(const ros::Publisher pub_path);
@@ -72,49 +87,23 @@ class LaserMapping {
     template <typename T>
     void SetPosestamp(T &out);
 
-    void PointBodyToWorld(PointType const *pi, PointType *const po);
-    PointType PointBodyToWorld(PointType const &pi);
-    void PointBodyToWorld(const common::V3F &pi, PointType *const po);
-    void PointBodyLidarToIMU(PointType const *const pi, PointType *const po);
-
-    void MapIncremental();
-
     void SubAndPubToROS();
 
-    bool LoadParams();
-    bool LoadParamsFromYAML(const std::string &yaml);
+    bool LoadParams(Options &options);
+    bool LoadParamsFromYAML(const std::string &yaml, Options &options);
+
+    /// hand the runtime parameters of the param server to the core, see LioCore::UpdateOptions
+    void ReloadParams();
 
     void PrintState(const state_ikfom &s);
 
    private:
+    Options options_;
+
     /// modules
-    IVoxType::Options ivox_options_;
-    std::shared_ptr<IVoxType> ivox_ = nullptr;                    // localmap in ivox
+    std::shared_ptr<LioCore> core_ = nullptr;                     // estimation
     std::shared_ptr<PointCloudPreprocess> preprocess_ = nullptr;  // point cloud preprocess
-    std::shared_ptr<ImuProcess> p_imu_ = nullptr;                 // imu process
-
-    /// local map related
-    float det_range_ = 300.0f;
-    double cube_len_ = 0;
-    double filter_size_map_min_ = 0;
-    bool localmap_initialized_ = false;
-
-    /// params
-    std::vector<double> extrinT_{3, 0.0};  // lidar-imu translation
-    std::vector<double> extrinR_{9, 0.0};  // lidar-imu rotation
-    std::string map_file_path_;
-
-    /// point clouds data
-    CloudPtr scan_undistort_{new PointCloudType()};   // scan after undistortion
-    CloudPtr scan_down_body_{new PointCloudType()};   // downsampled scan in body
-    CloudPtr scan_down_world_{new PointCloudType()};  // downsampled scan in world
-    std::vector<PointVector> nearest_points_;         // nearest points of current scan
-    common::VV4F corr_pts_;                           // inlier pts
-    common::VV4F corr_norm_;                          // inlier plane norms
-    pcl::VoxelGrid<PointType> voxel_scan_;            // voxel filter for current scan
-    std::vector<float> residuals_;                    // point-to-plane residuals
-    std::vector<bool> point_selected_surf_;           // selected points
-    common::VV4F plane_coef_;                         // plane coeffs
+    std::shared_ptr<MetricsServer> metrics_server_ = nullptr;     // exports the metrics of core_
 
     /// ros pub and sub stuffs
     ros::NodeHandle nh_;
@@ -129,66 +118,27 @@ class LaserMapping {
     ros::Publisher pub_path_;
     ros::ServiceServer start_lio_service_;
     ros::ServiceServer stop_lio_service_;
+    ros::ServiceServer reload_params_service_;
+    ros::ServiceServer dump_trace_service_;
     // std::string tf_imu_frame_;
     // std::string tf_world_frame_;
     tf::TransformListener tf_listener_;
-
-    std::mutex mtx_buffer_;
-    std::deque<double> time_buffer_;
-    std::deque<PointCloudType::Ptr> lidar_buffer_;
-    std::deque<sensor_msgs::Imu::ConstPtr> imu_buffer_;
+    tf::TransformBroadcaster tf_broadcaster_;
     nav_msgs::Odometry odom_aft_mapped_;
 
-    /// options
-    bool time_sync_en_ = false;
-    double timediff_lidar_wrt_imu_ = 0.0;
-    double last_timestamp_lidar_ = 0;
-    double lidar_end_time_ = 0;
-    double last_timestamp_imu_ = -1.0;
-    double first_lidar_time_ = 0.0;
-    bool lidar_pushed_ = false;
-
     /// statistics and flags ///
     int scan_count_ = 0;
     int publish_count_ = 0;
-    bool flg_first_scan_ = true;
-    bool flg_EKF_inited_ = false;
     int pcd_index_ = 0;
-    double lidar_mean_scantime_ = 0.0;
-    int scan_num_ = 0;
-    bool timediff_set_flg_ = false;
-    int effect_feat_num_ = 0, frame_num_ = 0;
-
-    ///////////////////////// EKF inputs and output ///////////////////////////////////////////////////////
-    common::MeasureGroup measures_;                    // sync IMU and lidar scan
-    esekfom::esekf<state_ikfom, 12, input_ikfom> kf_;  // esekf
-    state_ikfom state_point_;                          // ekf current state
-    vect3 pos_lidar_;                                  // lidar position after eskf update
-    common::V3D euler_cur_ = common::V3D::Zero();      // rotation in euler angles
-    bool extrinsic_est_en_ = true;
+    int frame_num_ = 0;
+    int scan_wait_num_ = 0;  // scans in pcl_wait_save_
 
     /////////////////////////  debug show / save /////////////////////////////////////////////////////////
     bool run_in_offline_ = false;
-    bool path_pub_en_ = true;
-    bool scan_pub_en_ = false;
-    bool dense_pub_en_ = false;
-    bool scan_body_pub_en_ = false;
-    bool scan_effect_pub_en_ = false;
-    bool pcd_save_en_ = false;
-    bool runtime_pos_log_ = true;
-    int pcd_save_interval_ = -1;
-    bool path_save_en_ = false;
-    std::string dataset_;
 
     PointCloudType::Ptr pcl_wait_save_{new PointCloudType()};  // debug save
     nav_msgs::Path path_;
     geometry_msgs::PoseStamped msg_body_pose_;
-
-    // turn on anf off
-    bool lidar_odom_ = true;
-    std::string base_link_frame_;
-    std::string lidar_frame_;
-    std::string global_frame_;
 };
 
 }  // namespace faster_lio
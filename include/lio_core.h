@@ -0,0 +1,267 @@
+#ifndef FASTER_LIO_LIO_CORE_H
+#define FASTER_LIO_LIO_CORE_H
+
+#include <pcl/filters/voxel_grid.h>
+#include <yaml-cpp/yaml.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "cloud_pool.h"
+#include "common_lib.h"
+#include "imu_processing.hpp"
+#include "ivox3d/ivox3d.h"
+#include "ivox3d/ivox3d_pyramid.h"
+#include "memory_account.h"
+#include "metrics.h"
+#include "options.h"
+#include "parallel_arena.h"
+#include "trace.h"
+#include "utils.h"
+
+namespace faster_lio {
+
+/**
+ * the estimation core of faster-lio, without any ros dependency
+ * inputs are imu samples and preprocessed scans (curvature holds the offset time of each point in ms),
+ * outputs are the state, its covariance and the registered scan. The ros node (LaserMapping) and the headless runner
+ * are thin adapters on top of it.
+ */
+class LioCore {
+   public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+#ifdef IVOX_NODE_TYPE_PHC
+    using IVoxType = IVox<3, IVoxNodeType::PHC, PointType>;
+    using IVoxPyramidType = IVoxPyramid<3, IVoxNodeType::PHC, PointType>;
+#elif defined(IVOX_NODE_TYPE_QUANTIZED)
+    using IVoxType = IVox<3, IVoxNodeType::QUANTIZED, PointType>;
+    using IVoxPyramidType = IVoxPyramid<3, IVoxNodeType::QUANTIZED, PointType>;
+#else
+    // the map keeps only the positions, matching reads nothing else
+    using IVoxType = IVox<3, IVoxNodeType::DEFAULT, PointType, MapPointXYZ>;
+    using IVoxPyramidType = IVoxPyramid<3, IVoxNodeType::DEFAULT, PointType, MapPointXYZ>;
+#endif
+    using KFType = esekfom::esekf<state_ikfom, 12, input_ikfom>;
+
+    struct Options {
+        /// int codes of the config files, see config/*.yaml
+        bool SetTypes(int ivox_nearby_type, int robust_kernel, int residual_type);
+        /// scalar noise of the config files, the extrinsic in row-major order
+        bool SetImuOptions(double gyr_cov, double acc_cov, double b_gyr_cov, double b_acc_cov,
+                           const std::vector<double> &extrinsic_T, const std::vector<double> &extrinsic_R);
+
+        IVoxType::Options ivox_options_;
+        std::vector<float> ivox_pyramid_resolutions_;  // grid size of the coarse levels
+        int ivox_pyramid_grid_capacity_ = 20;          // max points in one coarse grid
+        ParallelArena::Options arena_options_;
+        int trace_buffer_size_ = 0;            // events kept for the timeline, 0 for off
+        double memory_report_interval_ = 60;  // seconds between two memory reports in the log, 0 for off
+
+        int max_iterations_ = 4;            // max iterations of the iterated ekf
+        float esti_plane_threshold_ = 0.1;  // plane fitting threshold
+        double filter_size_surf_ = 0.5;     // voxel filter of the scan
+        double filter_size_map_ = 0.0;      // downsample of the map
+        bool time_sync_en_ = false;
+        ImuProcess::Options imu_options_;  // imu noise and lidar-imu extrinsic
+        bool extrinsic_est_en_ = true;
+
+        common::RobustKernel robust_kernel_ = common::RobustKernel::NONE;  // IRLS kernel of point-to-plane residuals
+        float robust_kernel_delta_ = 0.1;                                 // kernel width
+
+        bool point_cov_en_ = false;     // per-point noise from range, incidence angle and plane spread
+        float range_sigma_ = 0.02;      // lidar range noise std
+        float bearing_sigma_ = 0.0015;  // lidar bearing noise std in rad
+        common::ResidualType residual_type_ = common::ResidualType::POINT_TO_PLANE;
+        float distribution_min_variance_ = 0.001;     // added to the voxel variance along each axis
+        float distribution_max_mahalanobis2_ = 16.0;  // gate of the point-to-distribution residual
+    };
+
+    LioCore();
+    ~LioCore() = default;
+
+    /// init with given options
+    bool Init(const Options &options);
+
+    /// load the options of the core from a parsed config file
+    static bool LoadOptions(const YAML::Node &yaml, Options &options);
+
+    /// inputs, thread safe
+    void AddImu(const common::ImuData &imu);
+    void AddScan(double timestamp, const PointType *points, size_t num);
+    void AddScan(double timestamp, CloudPtr scan);  // takes the ownership of the scan
+
+    /**
+     * process one synced frame if there is one
+     * @return true if a frame is processed and the outputs are updated
+     */
+    bool Run();
+
+    void Reset();
+
+    /**
+     * request new runtime parameters, thread safe. They are applied together right before the next frame: the scan
+     * filter size, the ivox nearby type, the max iterations and the plane threshold. The other options shape the map
+     * or the filter and only take effect in Init()
+     */
+    void UpdateOptions(const Options &options);
+
+    /// start / stop the odometry, a stopped core only downsamples the scans
+    void SetOdomEnabled(bool enabled) { lidar_odom_ = enabled; }
+    bool OdomEnabled() const { return lidar_odom_; }
+
+    /// outputs of the last processed frame
+    double GetTime() const { return lidar_end_time_; }
+    const state_ikfom &GetState() const { return state_point_; }
+    const KFType::cov &GetCovariance() const { return kf_.get_P(); }
+    CloudPtr GetScanUndistort() const { return scan_undistort_; }   // dense scan in lidar frame
+    CloudPtr GetScanDownWorld() const { return scan_down_world_; }  // downsampled scan in world frame
+    int GetNumEffectiveFeatures() const { return effect_feat_num_; }
+
+    /// current pose in TUM format: timestamp x y z q_x q_y q_z q_w
+    void WriteTumPose(std::ostream &os) const;
+
+    /// time usage of the stages of this core
+    Timer &GetTimer() { return timer_; }
+    const Timer &GetTimer() const { return timer_; }
+
+    /// timeline of the stages, parallel chunks and buffer lock waits, may be dumped from any thread
+    Tracer &GetTracer() { return tracer_; }
+
+    /// live counters and histograms of this core, may be serialized from any thread
+    const MetricsRegistry &GetMetrics() const { return metrics_; }
+
+    /// recycled clouds for the scans and the published clouds of a frame, thread safe
+    CloudPool &GetCloudPool() { return cloud_pool_; }
+
+    /// heap bytes of the map, the scan buffers and the input queues, adapters add their own subsystems
+    MemoryAccount &GetMemoryAccount() { return memory_; }
+
+    PointType PointBodyToWorld(const PointType &pi) const;
+    void PointBodyLidarToIMU(PointType const *const pi, PointType *const po) const;
+
+    /// interface of mtk, customized obseravtion model
+    void ObsModel(state_ikfom &s, esekfom::dyn_share_datastruct<double> &ekfom_data);
+
+    /// replace the local map and the current downsampled scan, for benchmarking ObsModel without a bag
+    void SetMapAndScan(const PointVector &map_points, const PointVector &scan_body);
+
+   private:
+    // sync lidar with imu
+    bool SyncPackages();
+
+    void MapIncremental();
+
+    /// how a point of the current scan goes into the map
+    enum MapAdd : uint8_t { NOT_ADD = 0, ADD_DOWNSAMPLE = 1, ADD_NO_DOWNSAMPLE = 2 };
+    uint8_t MapAddFlag(const PointType &point_world, const PointType *points_near, int num_near) const;
+
+    /// exported tracking state, every change counts as a transition
+    enum class TrackState { TRACKING = 0, DEGENERATE = 1, STOPPED = 2 };
+    void SetTrackState(TrackState state);
+
+    /// latency histogram of a timer stage, registered at its first evaluation
+    void ObserveStage(const std::string &name, double time_ms);
+
+    /// count the bytes of the subsystems of the core and log them once per report interval
+    void UpdateMemoryAccount();
+
+    /// apply the options of UpdateOptions, only rebuilds what the changed values need
+    void ApplyPendingOptions();
+
+    /// resize the per-point buffers to the current scan
+    void PrepareScanBuffers(int cur_pts);
+
+    /// residual rows of one matched point
+    int RowsPerPoint() const { return options_.residual_type_ == common::ResidualType::POINT_TO_DISTRIBUTION ? 3 : 1; }
+
+    Options options_;
+    std::mutex mtx_options_;
+    std::unique_ptr<Options> pending_options_ = nullptr;  // requested by UpdateOptions, not applied yet
+    Timer timer_;
+    Tracer tracer_;
+
+    /// live metrics, the handles point into metrics_
+    MetricsRegistry metrics_;
+    struct MetricHandles {
+        MetricsRegistry::Counter *frames_ = nullptr;
+        MetricsRegistry::Counter *dropped_empty_ = nullptr;
+        MetricsRegistry::Counter *dropped_too_few_ = nullptr;
+        MetricsRegistry::Counter *dropped_loop_back_ = nullptr;
+        MetricsRegistry::Gauge *effective_features_ = nullptr;
+        MetricsRegistry::Histogram *iekf_iterations_ = nullptr;
+        MetricsRegistry::Gauge *map_voxels_ = nullptr;
+        MetricsRegistry::Gauge *map_points_ = nullptr;
+        MetricsRegistry::Gauge *lidar_queue_ = nullptr;
+        MetricsRegistry::Gauge *imu_queue_ = nullptr;
+        MetricsRegistry::Gauge *track_state_ = nullptr;
+        MetricsRegistry::Counter *transitions_[3] = {nullptr, nullptr, nullptr};  // by TrackState
+        std::unordered_map<std::string, MetricsRegistry::Histogram *> stage_latency_;
+    } metric_;
+    TrackState track_state_ = TrackState::TRACKING;
+    MemoryAccount memory_{metrics_};
+    std::chrono::steady_clock::time_point last_memory_report_ = std::chrono::steady_clock::now();
+
+    /// modules
+    std::shared_ptr<IVoxType> ivox_ = nullptr;                 // localmap in ivox, finest level of the pyramid
+    std::shared_ptr<IVoxPyramidType> ivox_pyramid_ = nullptr;  // multi-resolution localmap
+    std::shared_ptr<ImuProcess> p_imu_ = nullptr;              // imu process
+    std::shared_ptr<ParallelArena> arena_ = nullptr;           // threads of all parallel stages
+    tbb::affinity_partitioner match_partitioner_;  // one per loop, keeps scan chunks on the same threads
+    tbb::affinity_partitioner count_partitioner_;
+    tbb::affinity_partitioner jacobian_partitioner_;
+    tbb::affinity_partitioner map_partitioner_;
+
+    /// point clouds data
+    CloudPool cloud_pool_;                            // input scans, declared before the buffers holding them
+    CloudPtr scan_undistort_{new PointCloudType()};   // scan after undistortion
+    CloudPtr scan_down_body_{new PointCloudType()};   // downsampled scan in body
+    CloudPtr scan_down_world_{new PointCloudType()};  // downsampled scan in world
+    PointVector nearest_points_;                      // nearest points of current scan, NUM_MATCH_POINTS per point
+    std::vector<uint8_t> num_nearest_;                // number of valid nearest points of each point
+    pcl::VoxelGrid<PointType> voxel_scan_;            // voxel filter for current scan
+    std::vector<float> residuals_;                    // point-to-plane residuals
+    std::vector<float> weights_;                      // weights of the residuals, robust * noise
+    std::vector<float> noise_weights_;                // per-point noise weights, LASER_POINT_COV / var
+    std::vector<int> block_offsets_;                  // first jacobian column of every block of points
+    std::vector<uint8_t> map_add_flags_;              // MapAdd of every point
+    PointVector points_to_add_;                       // ADD_DOWNSAMPLE points of the scan
+    PointVector points_no_need_downsample_;           // ADD_NO_DOWNSAMPLE points of the scan
+    std::vector<uint8_t> point_selected_surf_;        // selected points, bytes so threads can write them freely
+    common::VV4F plane_coef_;                         // plane coeffs, one per residual row
+    esekfom::dyn_share_datastruct<double> obs_data_;  // jacobian and measurements, sized for the largest frame
+
+    /// input buffers
+    std::mutex mtx_buffer_;
+    std::deque<double> time_buffer_;
+    std::deque<PointCloudType::Ptr> lidar_buffer_;
+    std::deque<common::ImuData> imu_buffer_;
+    size_t lidar_buffer_bytes_ = 0;  // points of the scans in lidar_buffer_
+    size_t queue_bytes_ = 0;         // both queues, taken at the last sync
+    double timediff_lidar_wrt_imu_ = 0.0;
+    double last_timestamp_lidar_ = 0;
+    double lidar_end_time_ = 0;
+    double last_timestamp_imu_ = -1.0;
+    double first_lidar_time_ = 0.0;
+    bool lidar_pushed_ = false;
+
+    /// statistics and flags ///
+    bool flg_first_scan_ = true;
+    bool flg_EKF_inited_ = false;
+    double lidar_mean_scantime_ = 0.0;
+    int scan_num_ = 0;
+    int effect_feat_num_ = 0;
+    int obs_iter_ = 0;     // ObsModel calls in the current frame
+    int match_level_ = 0;  // pyramid level of the current correspondences
+    bool lidar_odom_ = true;
+
+    ///////////////////////// EKF inputs and output ///////////////////////////////////////////////////////
+    common::MeasureGroup measures_;  // sync IMU and lidar scan
+    KFType kf_;                      // esekf
+    state_ikfom state_point_;        // ekf current state
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_LIO_CORE_H
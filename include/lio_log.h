@@ -0,0 +1,129 @@
+#ifndef FASTER_LIO_LIO_LOG_H
+#define FASTER_LIO_LIO_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "common_lib.h"
+
+namespace faster_lio {
+
+class LioCore;
+
+/**
+ * native recording of preprocessed scans and imu samples, replayed without ros
+ *
+ * a log is a directory with one raw little-endian array per column, so the reader maps the files and reads them in
+ * place without any decoding:
+ *   header           LogHeader
+ *   imu_time         double[num_imu]
+ *   imu_acc          double[num_imu][3]
+ *   imu_gyro         double[num_imu][3]
+ *   scan_time        double[num_scans]     bag time of every scan
+ *   scan_end         uint64_t[num_scans]   end index of every scan in the point columns
+ *   point_xyz        float[num_points][3]  preprocessed points in the lidar frame
+ *   point_intensity  float[num_points]
+ *   point_time       float[num_points]     offset time in ms, the curvature of PointType
+ */
+namespace lio_log {
+
+constexpr char kMagic[8] = {'F', 'L', 'I', 'O', 'L', 'O', 'G', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct LogHeader {
+    char magic_[8];
+    uint32_t version_ = kVersion;
+    uint32_t reserved_ = 0;
+    uint64_t num_imu_ = 0;
+    uint64_t num_scans_ = 0;
+    uint64_t num_points_ = 0;
+};
+
+}  // namespace lio_log
+
+/// writes a log, columns are appended as the data comes in
+class LioLogWriter {
+   public:
+    LioLogWriter() = default;
+    ~LioLogWriter() { Close(); }
+
+    /// create the log directory and its column files
+    bool Open(const std::string &dir);
+
+    void AddImu(const common::ImuData &imu);
+    void AddScan(double timestamp, const PointCloudType &scan);
+
+    /// flush the columns and write the header, a log without header is rejected by the reader
+    bool Close();
+
+    const lio_log::LogHeader &Header() const { return header_; }
+
+   private:
+    enum Column { IMU_TIME = 0, IMU_ACC, IMU_GYRO, SCAN_TIME, SCAN_END, POINT_XYZ, POINT_INTENSITY, POINT_TIME, NUM };
+
+    std::string dir_;
+    std::ofstream columns_[NUM];
+    lio_log::LogHeader header_;
+    std::vector<float> xyz_, intensity_, time_;  // column buffers of one scan
+    bool opened_ = false;
+};
+
+/// reads a log through read-only memory maps
+class LioLogReader {
+   public:
+    LioLogReader() = default;
+    ~LioLogReader();
+
+    LioLogReader(const LioLogReader &) = delete;
+    LioLogReader &operator=(const LioLogReader &) = delete;
+
+    /// map the columns of a log and check them against the header
+    bool Open(const std::string &dir);
+
+    size_t NumImu() const { return header_.num_imu_; }
+    size_t NumScans() const { return header_.num_scans_; }
+    size_t NumPoints() const { return header_.num_points_; }
+
+    common::ImuData Imu(size_t i) const;
+
+    double ScanTime(size_t i) const { return scan_time_[i]; }
+    size_t ScanSize(size_t i) const { return scan_end_[i] - ScanBegin(i); }
+    /// stamp of the last point of a scan
+    double ScanEndTime(size_t i) const;
+
+    /// gather the columns of a scan into points
+    void GetScan(size_t i, PointCloudType &scan) const;
+
+    /**
+     * feed the log into a core in time order, the imu samples up to the end of a scan go in before it
+     * @param on_scan called after every scan with whether a frame was processed, return false to stop
+     * @return number of replayed scans
+     */
+    size_t Replay(LioCore &core, const std::function<bool(bool)> &on_scan) const;
+
+   private:
+    size_t ScanBegin(size_t i) const { return i == 0 ? 0 : scan_end_[i - 1]; }
+
+    /// map a column, checks that it holds exactly num values of type T
+    template <typename T>
+    bool Map(const std::string &path, size_t num, const T *&data);
+
+    std::vector<std::pair<void *, size_t>> maps_;  // address and length of every mapping
+    lio_log::LogHeader header_;
+
+    const double *imu_time_ = nullptr;
+    const double *imu_acc_ = nullptr;
+    const double *imu_gyro_ = nullptr;
+    const double *scan_time_ = nullptr;
+    const uint64_t *scan_end_ = nullptr;
+    const float *point_xyz_ = nullptr;
+    const float *point_intensity_ = nullptr;
+    const float *point_time_ = nullptr;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_LIO_LOG_H
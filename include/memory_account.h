@@ -0,0 +1,79 @@
+#ifndef FASTER_LIO_MEMORY_ACCOUNT_H
+#define FASTER_LIO_MEMORY_ACCOUNT_H
+
+#include <glog/logging.h>
+#include <cstddef>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "metrics.h"
+
+namespace faster_lio {
+
+/**
+ * current and peak heap bytes of the subsystems, e.g. the map, the input queues or the trajectory
+ * the bytes are counted on the containers (capacity times element size plus node overheads) by their owners, so they
+ * tell which subsystem grows, not what the allocator holds. Every subsystem is exported as
+ * memory_bytes{subsystem=...} and memory_peak_bytes{subsystem=...}. Not thread safe, update from one thread.
+ */
+class MemoryAccount {
+   public:
+    explicit MemoryAccount(MetricsRegistry &metrics) : metrics_(metrics) {}
+
+    /// set the current bytes of a subsystem, it is registered at the first call
+    void Set(const std::string &subsystem, size_t bytes) {
+        auto iter = usage_.find(subsystem);
+        if (iter == usage_.end()) {
+            const std::string labels = "subsystem=\"" + subsystem + "\"";
+            Usage usage;
+            usage.current_gauge_ = &metrics_.AddGauge("memory_bytes", "heap bytes held by a subsystem", labels);
+            usage.peak_gauge_ = &metrics_.AddGauge("memory_peak_bytes", "max of memory_bytes", labels);
+            iter = usage_.emplace(subsystem, usage).first;
+        }
+
+        auto &usage = iter->second;
+        usage.current_ = bytes;
+        usage.current_gauge_->Set(bytes);
+        if (bytes > usage.peak_) {
+            usage.peak_ = bytes;
+            usage.peak_gauge_->Set(bytes);
+        }
+    }
+
+    size_t TotalBytes() const {
+        size_t total = 0;
+        for (const auto &u : usage_) {
+            total += u.second.current_;
+        }
+        return total;
+    }
+
+    /// log current and peak of every subsystem in MB
+    void Report() const {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1) << "memory " << ToMB(TotalBytes()) << " MB:";
+        for (const auto &u : usage_) {
+            oss << " " << u.first << " " << ToMB(u.second.current_) << " (peak " << ToMB(u.second.peak_) << ")";
+        }
+        LOG(INFO) << oss.str();
+    }
+
+   private:
+    struct Usage {
+        size_t current_ = 0;
+        size_t peak_ = 0;
+        MetricsRegistry::Gauge *current_gauge_ = nullptr;
+        MetricsRegistry::Gauge *peak_gauge_ = nullptr;
+    };
+
+    static double ToMB(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+    MetricsRegistry &metrics_;
+    std::map<std::string, Usage> usage_;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_MEMORY_ACCOUNT_H
@@ -0,0 +1,114 @@
+#ifndef FASTER_LIO_METRICS_H
+#define FASTER_LIO_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace faster_lio {
+
+/**
+ * live counters, gauges and histograms, exported in the prometheus text format
+ * the estimation thread updates them through relaxed atomics and never takes a lock, an exporter serializes them from
+ * another thread. Registration and serialization share a mutex, register up front or at most once per metric.
+ */
+class MetricsRegistry {
+   public:
+    class Counter {
+       public:
+        void Inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+       private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    class Gauge {
+       public:
+        void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+        double Value() const { return value_.load(std::memory_order_relaxed); }
+
+       private:
+        std::atomic<double> value_{0.0};
+    };
+
+    class Histogram {
+       public:
+        /// @param bounds  upper bounds of the buckets in ascending order, +Inf is implied
+        explicit Histogram(std::vector<double> bounds);
+
+        void Observe(double value);
+
+       private:
+        friend class MetricsRegistry;
+
+        std::vector<double> bounds_;
+        std::unique_ptr<std::atomic<uint64_t>[]> counts_;  // per bucket and +Inf, not cumulative
+        std::atomic<uint64_t> count_{0};
+        std::atomic<double> sum_{0.0};
+    };
+
+    /**
+     * register a metric, the returned reference stays valid as long as the registry
+     * @param name  exported with the faster_lio_ prefix
+     * @param labels  label set in the exposition format, e.g. stage="Downsample", empty for none
+     */
+    Counter &AddCounter(const std::string &name, const std::string &help, const std::string &labels = "");
+    Gauge &AddGauge(const std::string &name, const std::string &help, const std::string &labels = "");
+    Histogram &AddHistogram(const std::string &name, const std::string &help, std::vector<double> bounds,
+                            const std::string &labels = "");
+
+    /// all metrics in the prometheus text exposition format, the samples of a name are grouped
+    std::string Serialize() const;
+
+   private:
+    enum class Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry {
+        std::string name_;
+        std::string help_;
+        std::string labels_;
+        Type type_;
+        const void *metric_;
+    };
+
+    mutable std::mutex mtx_;
+    std::deque<Counter> counters_;  // deques keep the addresses stable
+    std::deque<Gauge> gauges_;
+    std::deque<Histogram> histograms_;
+    std::vector<Entry> entries_;  // in registration order
+};
+
+/**
+ * serves the metrics of a registry over http, GET /metrics on a local port
+ * one background thread answers the scrapes one after another, the estimation is never blocked by it
+ */
+class MetricsServer {
+   public:
+    explicit MetricsServer(const MetricsRegistry &registry) : registry_(registry) {}
+    ~MetricsServer() { Stop(); }
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    /// listen on 127.0.0.1:port
+    bool Start(int port);
+    void Stop();
+
+   private:
+    void Serve();
+
+    const MetricsRegistry &registry_;
+    int fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_METRICS_H
@@ -0,0 +1,166 @@
+#ifndef FASTER_LIO_PARALLEL_ARENA_H
+#define FASTER_LIO_PARALLEL_ARENA_H
+
+#define TBB_PREVIEW_LOCAL_OBSERVER 1
+#include <glog/logging.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "trace.h"
+
+namespace faster_lio {
+
+/**
+ * task arena shared by all parallel stages of the pipeline
+ * the number of threads, the cores they are pinned to and the grain size are configurable, so the estimation does
+ * not compete with other nodes for arbitrary cores. The loops take an affinity_partitioner owned by the caller, with
+ * one partitioner per loop the same chunk of a scan goes to the same thread in every IEKF iteration.
+ */
+class ParallelArena {
+   public:
+    struct Options {
+        int num_threads_ = 0;       // 0 for automatic
+        std::vector<int> cpu_ids_;  // cores to pin the threads to, empty for no pinning
+        int grain_size_ = 64;       // min number of points in one task
+    };
+
+    explicit ParallelArena(Options options) : options_(std::move(options)) {
+        options_.grain_size_ = std::max(options_.grain_size_, 1);
+        if (options_.num_threads_ > 0) {
+            arena_ = std::make_unique<tbb::task_arena>(options_.num_threads_);
+        } else {
+            arena_ = std::make_unique<tbb::task_arena>();
+        }
+        arena_->initialize();
+
+        if (!options_.cpu_ids_.empty()) {
+            pinning_ = std::make_unique<PinningObserver>(*arena_, options_.cpu_ids_);
+        }
+        LOG(INFO) << "parallel arena with " << arena_->max_concurrency() << " threads, pinned to "
+                  << options_.cpu_ids_.size() << " cores, grain " << options_.grain_size_;
+    }
+
+    ~ParallelArena() {
+        if (pinning_) {
+            pinning_->observe(false);
+        }
+    }
+
+    /**
+     * parallel for over [begin, end) with the configured grain size
+     * @param partitioner  keep one per loop to reuse the thread-chunk mapping across calls
+     * @param func  called with a tbb::blocked_range<int>
+     */
+    template <typename Func>
+    void ParallelFor(int begin, int end, tbb::affinity_partitioner &partitioner, const Func &func) const {
+        ParallelFor(begin, end, options_.grain_size_, partitioner, func);
+    }
+
+    /// parallel for with a specific grain size, e.g. for loops over blocks of points
+    template <typename Func>
+    void ParallelFor(int begin, int end, int grain_size, tbb::affinity_partitioner &partitioner,
+                     const Func &func) const {
+        if (tracer_ == nullptr || !tracer_->Enabled()) {
+            arena_->execute([&]() {
+                tbb::parallel_for(tbb::blocked_range<int>(begin, end, std::max(grain_size, 1)), func, partitioner);
+            });
+            return;
+        }
+
+        // one span per chunk, the gaps between them on a worker are idle time
+        auto traced_func = [&](const tbb::blocked_range<int> &r) {
+            TraceScope scope(tracer_, "parallel chunk");
+            func(r);
+        };
+        arena_->execute([&]() {
+            tbb::parallel_for(tbb::blocked_range<int>(begin, end, std::max(grain_size, 1)), traced_func, partitioner);
+        });
+    }
+
+    int GrainSize() const { return options_.grain_size_; }
+
+    /// record the chunks of the loops in a timeline, null for none
+    void SetTracer(Tracer *tracer) { tracer_ = tracer; }
+
+   private:
+    /// pin every thread entering the arena to one of the given cores, its previous mask is restored when it leaves,
+    /// so the calling thread and the global tbb workers are not left pinned after a loop
+    class PinningObserver : public tbb::task_scheduler_observer {
+       public:
+        PinningObserver(tbb::task_arena &arena, std::vector<int> cpu_ids)
+            : tbb::task_scheduler_observer(arena), cpu_ids_(std::move(cpu_ids)) {
+            observe(true);
+        }
+
+        void on_scheduler_entry(bool is_worker) override {
+#ifdef __linux__
+            // always pushed, so that every exit pops the mask of its own entry
+            SavedMask saved;
+            saved.valid_ = pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &saved.cpu_set_) == 0;
+            SavedMasks().emplace_back(saved);
+
+            const int slot = tbb::this_task_arena::current_thread_index();
+            if (slot < 0 || !saved.valid_) {
+                return;
+            }
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu_ids_[slot % cpu_ids_.size()], &cpu_set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0) {
+                LOG(WARNING) << "failed to pin thread " << slot << " to cpu " << cpu_ids_[slot % cpu_ids_.size()];
+            }
+#endif
+        }
+
+        void on_scheduler_exit(bool is_worker) override {
+#ifdef __linux__
+            auto &saved_masks = SavedMasks();
+            if (saved_masks.empty()) {
+                return;  // entered before the observer was enabled
+            }
+            const SavedMask saved = saved_masks.back();
+            saved_masks.pop_back();
+            if (saved.valid_ && pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &saved.cpu_set_) != 0) {
+                LOG(WARNING) << "failed to restore the cpu mask of a thread leaving the arena";
+            }
+#endif
+        }
+
+       private:
+#ifdef __linux__
+        struct SavedMask {
+            bool valid_ = false;
+            cpu_set_t cpu_set_;
+        };
+
+        /// masks of the current thread before it entered, a stack as a thread may enter nested arenas
+        static std::vector<SavedMask> &SavedMasks() {
+            thread_local std::vector<SavedMask> saved_masks;
+            return saved_masks;
+        }
+#endif
+
+        std::vector<int> cpu_ids_;
+    };
+
+    Options options_;
+    std::unique_ptr<tbb::task_arena> arena_ = nullptr;
+    std::unique_ptr<PinningObserver> pinning_ = nullptr;
+    Tracer *tracer_ = nullptr;
+};
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_PARALLEL_ARENA_H
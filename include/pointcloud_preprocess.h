@@ -2,6 +2,7 @@
 #define FASTER_LIO_POINTCLOUD_PROCESSING_H
 
 #include <pcl_conversions/pcl_conversions.h>
+#include <yaml-cpp/yaml.h>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -64,35 +65,50 @@ class PointCloudPreprocess {
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
+    struct Options {
+        /// int code of the config files
+        bool SetLidarType(int lidar_type);
+
+        LidarType lidar_type_ = LidarType::AVIA;
+        bool feature_enabled_ = false;
+        int point_filter_num_ = 1;  // keep one of every n points
+        int num_scans_ = 6;         // lines of the lidar
+        double blind_ = 0.01;       // points closer than this are dropped
+        float time_scale_ = 1e-3;   // point time to ms, velodyne only
+    };
+
     PointCloudPreprocess() = default;
+    explicit PointCloudPreprocess(const Options &options) : options_(options) {}
     ~PointCloudPreprocess() = default;
 
+    /// load the preprocess keys of a config file
+    static bool LoadOptions(const YAML::Node &yaml, Options &options);
+
     /// processors
     void Process(const sensor_msgs::PointCloud2::ConstPtr &msg, PointCloudType::Ptr &pcl_out);
-    void Set(LidarType lid_type, double bld, int pfilt_num);
 
-    // accessors
-    double &Blind() { return blind_; }
-    int &NumScans() { return num_scans_; }
-    int &PointFilterNum() { return point_filter_num_; }
-    bool &FeatureEnabled() { return feature_enabled_; }
-    float &TimeScale() { return time_scale_; }
-    LidarType GetLidarType() const { return lidar_type_; }
-    void SetLidarType(LidarType lt) { lidar_type_ = lt; }
+    const Options &GetOptions() const { return options_; }
 
    private:
     void Oust64Handler(const sensor_msgs::PointCloud2::ConstPtr &msg);
     void VelodyneHandler(const sensor_msgs::PointCloud2::ConstPtr &msg);
 
-    PointCloudType cloud_full_, cloud_out_;
+    /// convert a message into a driver cloud, the buffers are reused across messages
+    template <typename PointT>
+    void FromMsg(const sensor_msgs::PointCloud2 &msg, pcl::PointCloud<PointT> &cloud);
 
-    LidarType lidar_type_ = LidarType::AVIA;
-    bool feature_enabled_ = false;
-    int point_filter_num_ = 1;
-    int num_scans_ = 6;
-    double blind_ = 0.01;
-    float time_scale_ = 1e-3;
+    Options options_;
+    PointCloudType cloud_full_, cloud_out_;
     bool given_offset_time_ = false;
+
+    /// scratch of the handlers
+    pcl::PCLPointCloud2 msg_cloud_;
+    pcl::PointCloud<ouster_ros::Point> ouster_cloud_;
+    pcl::PointCloud<velodyne_ros::Point> velodyne_cloud_;
+    std::vector<bool> is_first_;    // per line, no point seen yet
+    std::vector<double> yaw_fp_;    // per line, yaw of the first point
+    std::vector<float> yaw_last_;   // per line, yaw of the last point
+    std::vector<float> time_last_;  // per line, last offset time
 };
 }  // namespace faster_lio
 
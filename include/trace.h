@@ -0,0 +1,107 @@
+#ifndef FASTER_LIO_TRACE_H
+#define FASTER_LIO_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace faster_lio {
+
+/**
+ * timeline of the pipeline, dumped in the chrome trace format (chrome://tracing, ui.perfetto.dev)
+ * every event is a named span with the id of the thread it ran on. The events go into a ring buffer of fixed size, so
+ * a long run keeps its most recent part. Recording takes no lock, one slot is claimed with an atomic index and
+ * guarded by a sequence number, so a dump can run at any time from any thread.
+ */
+class Tracer {
+   public:
+    Tracer() = default;
+    ~Tracer() = default;
+
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    /**
+     * drop the recorded events and set the size of the ring buffer, 0 turns tracing off
+     * not thread safe, call it before the threads start recording
+     */
+    void Reset(size_t capacity);
+
+    bool Enabled() const { return capacity_ > 0; }
+
+    /// steady clock in ns, the time base of the events
+    static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /// record a span of the calling thread, leading spaces of the name are dropped
+    void Record(const char *name, int64_t begin_ns, int64_t end_ns);
+
+    /// label the calling thread in the dump
+    void SetThreadName(const std::string &name);
+
+    /// write the events in the buffer as chrome trace json, oldest first
+    bool Dump(const std::string &file_name) const;
+
+   private:
+    static constexpr size_t kMaxNameLength = 47;
+
+    struct Event {
+        std::atomic<uint64_t> seq_{0};  // 1 + index of the event held, 0 while it is written
+        char name_[kMaxNameLength + 1];
+        uint32_t tid_ = 0;
+        int64_t begin_ns_ = 0;
+        int64_t end_ns_ = 0;
+    };
+
+    size_t capacity_ = 0;
+    std::unique_ptr<Event[]> events_ = nullptr;
+    std::atomic<uint64_t> next_{0};  // index of the next event
+
+    mutable std::mutex mtx_names_;
+    std::map<uint32_t, std::string> thread_names_;
+};
+
+/// records the lifetime of the scope, does nothing if the tracer is null or off
+class TraceScope {
+   public:
+    TraceScope(Tracer *tracer, const char *name)
+        : tracer_(tracer != nullptr && tracer->Enabled() ? tracer : nullptr), name_(name) {
+        if (tracer_ != nullptr) {
+            begin_ns_ = Tracer::Now();
+        }
+    }
+    ~TraceScope() {
+        if (tracer_ != nullptr) {
+            tracer_->Record(name_, begin_ns_, Tracer::Now());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+   private:
+    Tracer *tracer_;
+    const char *name_;
+    int64_t begin_ns_ = 0;
+};
+
+/// lock a mutex, only a wait for it shows up in the trace
+inline std::unique_lock<std::mutex> TracedLock(std::mutex &mtx, Tracer *tracer, const char *name) {
+    std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        TraceScope scope(tracer, name);
+        lock.lock();
+    }
+    return lock;
+}
+
+}  // namespace faster_lio
+
+#endif  // FASTER_LIO_TRACE_H
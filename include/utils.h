@@ -7,14 +7,19 @@
 
 #include <glog/logging.h>
 #include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <numeric>
 #include <string>
+#include <vector>
+
+#include "trace.h"
 
 namespace faster_lio {
 
-/// timer
+/// timer, every estimator keeps its own records so several of them can run in one process
 class Timer {
    public:
     struct TimerRecord {
@@ -34,9 +39,12 @@ class Timer {
      * @param func_name
      */
     template <class F>
-    static void Evaluate(F&& func, const std::string& func_name) {
+    void Evaluate(F&& func, const std::string& func_name) {
         auto t1 = std::chrono::high_resolution_clock::now();
-        std::forward<F>(func)();
+        {
+            TraceScope scope(tracer_, func_name.c_str());
+            std::forward<F>(func)();
+        }
         auto t2 = std::chrono::high_resolution_clock::now();
         auto time_used = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() * 1000;
 
@@ -45,10 +53,19 @@ class Timer {
         } else {
             records_.insert({func_name, TimerRecord(func_name, time_used)});
         }
+        if (observer_) {
+            observer_(func_name, time_used);
+        }
     }
 
+    /// called with the name and the time usage in ms of every evaluation, e.g. to feed live metrics
+    void SetObserver(std::function<void(const std::string&, double)> observer) { observer_ = std::move(observer); }
+
+    /// also record every evaluation as a span of the timeline, null for none
+    void SetTracer(Tracer* tracer) { tracer_ = tracer; }
+
     /// print the run time
-    static void PrintAll() {
+    void PrintAll() const {
         LOG(INFO) << ">>> ===== Printing run time =====";
         for (const auto& r : records_) {
             LOG(INFO) << "> [ " << r.first << " ] average time usage: "
@@ -60,7 +77,7 @@ class Timer {
     }
 
     /// dump to a log file
-    static void DumpIntoFile(const std::string& file_name) {
+    void DumpIntoFile(const std::string& file_name) const {
         std::ofstream ofs(file_name, std::ios::out);
         if (!ofs.is_open()) {
             LOG(ERROR) << "Failed to open file: " << file_name;
@@ -92,21 +109,47 @@ class Timer {
     }
 
     /// get the average time usage of a function
-    static double GetMeanTime(const std::string& func_name) {
-        if (records_.find(func_name) == records_.end()) {
+    double GetMeanTime(const std::string& func_name) const {
+        auto iter = records_.find(func_name);
+        if (iter == records_.end()) {
             return 0.0;
         }
 
-        auto r = records_[func_name];
+        const auto& r = iter->second;
         return std::accumulate(r.time_usage_in_ms_.begin(), r.time_usage_in_ms_.end(), 0.0) /
                double(r.time_usage_in_ms_.size());
     }
 
     /// clean the records
-    static void Clear() { records_.clear(); }
+    void Clear() { records_.clear(); }
+
+   private:
+    std::map<std::string, TimerRecord> records_;
+    std::function<void(const std::string&, double)> observer_;
+    Tracer* tracer_ = nullptr;
+};
+
+/// polls the modification time of a file, e.g. to pick up edits of a config file while running
+class FileWatcher {
+   public:
+    explicit FileWatcher(std::string path) : path_(std::move(path)) { Changed(); }
+
+    /// true once after every write to the file
+    bool Changed() {
+        std::error_code ec;
+        auto write_time = std::filesystem::last_write_time(path_, ec);
+        if (ec || write_time == last_write_time_) {
+            return false;
+        }
+        last_write_time_ = write_time;
+        return true;
+    }
+
+    const std::string& Path() const { return path_; }
 
    private:
-    static std::map<std::string, TimerRecord> records_;
+    std::string path_;
+    std::filesystem::file_time_type last_write_time_;
 };
 
 }  // namespace faster_lio
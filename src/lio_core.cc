@@ -0,0 +1,766 @@
+#include <tbb/blocked_range.h>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+#include "lio_core.h"
+#include "utils.h"
+
+namespace faster_lio {
+
+bool LioCore::Options::SetTypes(int ivox_nearby_type, int robust_kernel, int residual_type) {
+    if (ivox_nearby_type == 0) {
+        ivox_options_.nearby_type_ = IVoxType::NearbyType::CENTER;
+    } else if (ivox_nearby_type == 6) {
+        ivox_options_.nearby_type_ = IVoxType::NearbyType::NEARBY6;
+    } else if (ivox_nearby_type == 18) {
+        ivox_options_.nearby_type_ = IVoxType::NearbyType::NEARBY18;
+    } else if (ivox_nearby_type == 26) {
+        ivox_options_.nearby_type_ = IVoxType::NearbyType::NEARBY26;
+    } else {
+        LOG(WARNING) << "unknown ivox_nearby_type, use NEARBY18";
+        ivox_options_.nearby_type_ = IVoxType::NearbyType::NEARBY18;
+    }
+
+    if (robust_kernel == 1) {
+        robust_kernel_ = common::RobustKernel::HUBER;
+        LOG(INFO) << "Using Huber kernel, delta " << robust_kernel_delta_;
+    } else if (robust_kernel == 2) {
+        robust_kernel_ = common::RobustKernel::CAUCHY;
+        LOG(INFO) << "Using Cauchy kernel, delta " << robust_kernel_delta_;
+    } else {
+        robust_kernel_ = common::RobustKernel::NONE;
+    }
+
+    if (residual_type == 1) {
+        residual_type_ = common::ResidualType::POINT_TO_DISTRIBUTION;
+        ivox_options_.keep_distribution_ = true;  // the other residuals never read them
+        LOG(INFO) << "Using point-to-distribution residual";
+    } else {
+        residual_type_ = common::ResidualType::POINT_TO_PLANE;
+        ivox_options_.keep_distribution_ = false;
+    }
+    return true;
+}
+
+LioCore::LioCore() {
+    metric_.frames_ = &metrics_.AddCounter("frames_total", "frames through the ekf update");
+    const std::string dropped_help = "scans skipped before the ekf update";
+    metric_.dropped_empty_ = &metrics_.AddCounter("dropped_scans_total", dropped_help, "reason=\"empty\"");
+    metric_.dropped_too_few_ = &metrics_.AddCounter("dropped_scans_total", dropped_help, "reason=\"too_few_points\"");
+    metric_.dropped_loop_back_ = &metrics_.AddCounter("dropped_scans_total", dropped_help, "reason=\"loop_back\"");
+    metric_.effective_features_ = &metrics_.AddGauge("effective_features", "matched points of the last update");
+    metric_.iekf_iterations_ =
+        &metrics_.AddHistogram("iekf_iterations", "observation model calls per frame", {1, 2, 3, 4, 5, 6, 8, 10});
+    metric_.map_voxels_ = &metrics_.AddGauge("map_voxels", "voxels of the finest map level");
+    metric_.map_points_ = &metrics_.AddGauge("map_points", "points of the finest map level");
+    metric_.lidar_queue_ = &metrics_.AddGauge("queue_depth", "buffered inputs", "queue=\"lidar\"");
+    metric_.imu_queue_ = &metrics_.AddGauge("queue_depth", "buffered inputs", "queue=\"imu\"");
+    metric_.track_state_ =
+        &metrics_.AddGauge("track_state", "0 tracking, 1 degenerate (no effective points), 2 odometry stopped");
+    const char *const state_names[] = {"tracking", "degenerate", "stopped"};
+    for (int i = 0; i < 3; ++i) {
+        metric_.transitions_[i] = &metrics_.AddCounter("track_state_transitions_total", "changes of track_state",
+                                                       std::string("to=\"") + state_names[i] + "\"");
+    }
+
+    timer_.SetObserver([this](const std::string &name, double time_ms) { ObserveStage(name, time_ms); });
+    timer_.SetTracer(&tracer_);
+}
+
+bool LioCore::Options::SetImuOptions(double gyr_cov, double acc_cov, double b_gyr_cov, double b_acc_cov,
+                                     const std::vector<double> &extrinsic_T, const std::vector<double> &extrinsic_R) {
+    if (extrinsic_T.size() != 3 || extrinsic_R.size() != 9) {
+        LOG(ERROR) << "extrinsic_T needs 3 values and extrinsic_R 9, got " << extrinsic_T.size() << " and "
+                   << extrinsic_R.size();
+        return false;
+    }
+
+    imu_options_.gyr_cov_ = common::V3D::Constant(gyr_cov);
+    imu_options_.acc_cov_ = common::V3D::Constant(acc_cov);
+    imu_options_.b_gyr_cov_ = common::V3D::Constant(b_gyr_cov);
+    imu_options_.b_acc_cov_ = common::V3D::Constant(b_acc_cov);
+    imu_options_.extrinsic_T_ = common::VecFromArray<double>(extrinsic_T);
+    imu_options_.extrinsic_R_ = common::MatFromArray<double>(extrinsic_R);
+    return true;
+}
+
+bool LioCore::LoadOptions(const YAML::Node &yaml, Options &options) {
+    int ivox_nearby_type, robust_kernel, residual_type;
+    try {
+        options.max_iterations_ = yaml["max_iteration"].as<int>();
+        options.esti_plane_threshold_ = yaml["esti_plane_threshold"].as<float>();
+        robust_kernel = yaml["robust_kernel"].as<int>(0);
+        options.robust_kernel_delta_ = yaml["robust_kernel_delta"].as<float>(0.1);
+        options.point_cov_en_ = yaml["point_cov"]["enable"].as<bool>(false);
+        options.range_sigma_ = yaml["point_cov"]["range_sigma"].as<float>(0.02);
+        options.bearing_sigma_ = yaml["point_cov"]["bearing_sigma"].as<float>(0.0015);
+        residual_type = yaml["residual_type"].as<int>(0);
+        options.distribution_min_variance_ = yaml["distribution"]["min_variance"].as<float>(0.001);
+        options.distribution_max_mahalanobis2_ = yaml["distribution"]["max_mahalanobis2"].as<float>(16.0);
+        options.time_sync_en_ = yaml["common"]["time_sync_en"].as<bool>();
+
+        options.filter_size_surf_ = yaml["filter_size_surf"].as<float>();
+        options.filter_size_map_ = yaml["filter_size_map"].as<float>();
+        options.extrinsic_est_en_ = yaml["mapping"]["extrinsic_est_en"].as<bool>();
+        if (!options.SetImuOptions(yaml["mapping"]["gyr_cov"].as<double>(), yaml["mapping"]["acc_cov"].as<double>(),
+                                   yaml["mapping"]["b_gyr_cov"].as<double>(), yaml["mapping"]["b_acc_cov"].as<double>(),
+                                   yaml["mapping"]["extrinsic_T"].as<std::vector<double>>(),
+                                   yaml["mapping"]["extrinsic_R"].as<std::vector<double>>())) {
+            return false;
+        }
+
+        options.ivox_options_.resolution_ = yaml["ivox_grid_resolution"].as<float>();
+        ivox_nearby_type = yaml["ivox_nearby_type"].as<int>();
+        options.ivox_options_.expected_grids_ = yaml["ivox_expected_grids"].as<std::size_t>(0);
+        options.ivox_pyramid_resolutions_ =
+            yaml["ivox_pyramid"]["resolutions"].as<std::vector<float>>(std::vector<float>());
+        options.ivox_pyramid_grid_capacity_ = yaml["ivox_pyramid"]["grid_capacity"].as<int>(20);
+        options.arena_options_.num_threads_ = yaml["parallel"]["num_threads"].as<int>(0);
+        options.arena_options_.cpu_ids_ = yaml["parallel"]["cpu_ids"].as<std::vector<int>>(std::vector<int>());
+        options.arena_options_.grain_size_ = yaml["parallel"]["grain_size"].as<int>(64);
+        if (yaml["trace"]) {
+            options.trace_buffer_size_ = yaml["trace"]["buffer_size"].as<int>(0);
+        }
+        if (yaml["memory"]) {
+            options.memory_report_interval_ = yaml["memory"]["report_interval"].as<double>(60);
+        }
+    } catch (...) {
+        LOG(ERROR) << "bad conversion";
+        return false;
+    }
+
+    return options.SetTypes(ivox_nearby_type, robust_kernel, residual_type);
+}
+
+bool LioCore::Init(const Options &options) {
+    options_ = options;
+
+    // localmap init (after LoadParams)
+    ivox_pyramid_ = std::make_shared<IVoxPyramidType>(options_.ivox_options_, options_.ivox_pyramid_resolutions_,
+                                                      options_.ivox_pyramid_grid_capacity_);
+    ivox_ = ivox_pyramid_->Level(0);
+    arena_ = std::make_shared<ParallelArena>(options_.arena_options_);
+    tracer_.Reset(std::max(options_.trace_buffer_size_, 0));
+    arena_->SetTracer(&tracer_);
+
+    // esekf init
+    std::vector<double> epsi(23, 0.001);
+    // the observation model is handed to the update directly, see Run()
+    kf_.init_dyn_runtime_share(get_f, df_dx, df_dw, options_.max_iterations_, epsi.data());
+
+    const double filter_size_surf = options_.filter_size_surf_;
+    voxel_scan_.setLeafSize(filter_size_surf, filter_size_surf, filter_size_surf);
+
+    p_imu_ = std::make_shared<ImuProcess>(options_.imu_options_, timer_);
+
+    if (std::is_same<IVoxType, IVox<3, IVoxNodeType::PHC, pcl::PointXYZI>>::value == true) {
+        LOG(INFO) << "using phc ivox";
+    } else if (std::is_same<IVoxType, IVox<3, IVoxNodeType::DEFAULT, pcl::PointXYZI>>::value == true) {
+        LOG(INFO) << "using default ivox";
+    }
+    return true;
+}
+
+void LioCore::Reset() {
+    // cleared map
+    ivox_pyramid_->Reset();
+    flg_first_scan_ = true;
+    p_imu_->Reset();
+
+    std::lock_guard<std::mutex> lock(mtx_buffer_);
+    lidar_buffer_.clear();
+    time_buffer_.clear();
+    lidar_buffer_bytes_ = 0;
+    lidar_pushed_ = false;
+}
+
+void LioCore::UpdateOptions(const Options &options) {
+    std::lock_guard<std::mutex> lock(mtx_options_);
+    pending_options_ = std::make_unique<Options>(options);
+}
+
+void LioCore::ApplyPendingOptions() {
+    std::unique_ptr<Options> options;
+    {
+        std::lock_guard<std::mutex> lock(mtx_options_);
+        options.swap(pending_options_);
+    }
+    if (options == nullptr) {
+        return;
+    }
+
+    if (options->filter_size_surf_ != options_.filter_size_surf_) {
+        options_.filter_size_surf_ = options->filter_size_surf_;
+        const double filter_size_surf = options_.filter_size_surf_;
+        voxel_scan_.setLeafSize(filter_size_surf, filter_size_surf, filter_size_surf);
+        LOG(INFO) << "filter_size_surf set to " << filter_size_surf;
+    }
+    if (options->ivox_options_.nearby_type_ != options_.ivox_options_.nearby_type_) {
+        // only the neighbour offsets change, the grids stay
+        options_.ivox_options_.nearby_type_ = options->ivox_options_.nearby_type_;
+        ivox_pyramid_->SetNearbyType(options_.ivox_options_.nearby_type_);
+        LOG(INFO) << "ivox nearby type set to " << static_cast<int>(options_.ivox_options_.nearby_type_);
+    }
+    if (options->max_iterations_ != options_.max_iterations_) {
+        options_.max_iterations_ = options->max_iterations_;
+        kf_.change_maximum_iter(options_.max_iterations_);
+        LOG(INFO) << "max_iteration set to " << options_.max_iterations_;
+    }
+    if (options->esti_plane_threshold_ != options_.esti_plane_threshold_) {
+        options_.esti_plane_threshold_ = options->esti_plane_threshold_;  // read by every ObsModel call
+        LOG(INFO) << "esti_plane_threshold set to " << options_.esti_plane_threshold_;
+    }
+}
+
+void LioCore::SetTrackState(TrackState state) {
+    if (state == track_state_) {
+        return;
+    }
+    track_state_ = state;
+    metric_.track_state_->Set(static_cast<int>(state));
+    metric_.transitions_[static_cast<int>(state)]->Inc();
+}
+
+void LioCore::ObserveStage(const std::string &name, double time_ms) {
+    auto iter = metric_.stage_latency_.find(name);
+    if (iter == metric_.stage_latency_.end()) {
+        // the timer indents the nested stages
+        const std::string stage = name.substr(std::min(name.find_first_not_of(' '), name.size()));
+        auto &histogram =
+            metrics_.AddHistogram("stage_latency_ms", "time usage of the pipeline stages",
+                                  {0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250}, "stage=\"" + stage + "\"");
+        iter = metric_.stage_latency_.emplace(name, &histogram).first;
+    }
+    iter->second->Observe(time_ms);
+}
+
+void LioCore::AddScan(double timestamp, const PointType *points, size_t num) {
+    CloudPtr scan = cloud_pool_.Acquire();
+    scan->points.assign(points, points + num);
+    scan->width = num;
+    scan->height = 1;
+    AddScan(timestamp, scan);
+}
+
+void LioCore::AddScan(double timestamp, CloudPtr scan) {
+    auto lock = TracedLock(mtx_buffer_, &tracer_, "wait mtx_buffer_");
+    if (timestamp < last_timestamp_lidar_) {
+        LOG(ERROR) << "lidar loop back, clear buffer";
+        metric_.dropped_loop_back_->Inc(lidar_buffer_.size());
+        lidar_buffer_.clear();
+        lidar_buffer_bytes_ = 0;
+    }
+
+    lidar_buffer_bytes_ += scan->points.capacity() * sizeof(PointType);
+    lidar_buffer_.push_back(scan);
+    time_buffer_.push_back(timestamp);
+    last_timestamp_lidar_ = timestamp;
+    metric_.lidar_queue_->Set(lidar_buffer_.size());
+}
+
+void LioCore::AddImu(const common::ImuData &imu) {
+    common::ImuData data = imu;
+    if (std::abs(timediff_lidar_wrt_imu_) > 0.1 && options_.time_sync_en_) {
+        data.timestamp_ += timediff_lidar_wrt_imu_;
+    }
+
+    auto lock = TracedLock(mtx_buffer_, &tracer_, "wait mtx_buffer_");
+    if (data.timestamp_ < last_timestamp_imu_) {
+        LOG(WARNING) << "imu loop back, clear buffer";
+        imu_buffer_.clear();
+    }
+
+    last_timestamp_imu_ = data.timestamp_;
+    imu_buffer_.emplace_back(data);
+    metric_.imu_queue_->Set(imu_buffer_.size());
+}
+
+bool LioCore::Run() {
+    ApplyPendingOptions();
+    if (!SyncPackages()) {
+        return false;
+    }
+
+    /// IMU process, kf prediction, undistortion
+    p_imu_->Process(measures_, kf_, scan_undistort_);
+    if (scan_undistort_->empty() || (scan_undistort_ == nullptr)) {
+        LOG(WARNING) << "No point, skip this scan!";
+        metric_.dropped_empty_->Inc();
+        return false;
+    }
+
+    if (!lidar_odom_) {
+        voxel_scan_.setInputCloud(scan_undistort_);
+        scan_down_body_->clear();
+        scan_down_world_->clear();
+        voxel_scan_.filter(*scan_down_body_);
+        scan_down_world_->reserve(scan_down_body_->size());
+        std::for_each(scan_down_body_->begin(), scan_down_body_->end(),
+                      [&](const auto &point) { scan_down_world_->push_back(PointBodyToWorld(point)); });
+        flg_first_scan_ = true;
+        SetTrackState(TrackState::STOPPED);
+        UpdateMemoryAccount();
+        return true;
+    }
+
+    /// the first scan
+    if (flg_first_scan_) {
+        ivox_pyramid_->AddPoints(scan_undistort_->points);
+        first_lidar_time_ = measures_.lidar_bag_time_;
+        flg_first_scan_ = false;
+        return false;
+    }
+    flg_EKF_inited_ = (measures_.lidar_bag_time_ - first_lidar_time_) >= options::INIT_TIME;
+
+    /// downsample
+    timer_.Evaluate(
+        [&, this]() {
+            voxel_scan_.setInputCloud(scan_undistort_);
+            voxel_scan_.filter(*scan_down_body_);
+        },
+        "Downsample PointCloud");
+
+    int cur_pts = scan_down_body_->size();
+    if (cur_pts < 5) {
+        lidar_odom_ = false;
+        LOG(WARNING) << "Too few points, skip this scan!" << scan_undistort_->size() << ", " << scan_down_body_->size();
+        metric_.dropped_too_few_->Inc();
+        SetTrackState(TrackState::STOPPED);
+        return false;
+    }
+    PrepareScanBuffers(cur_pts);
+
+    // ICP and iterated Kalman filter update
+    timer_.Evaluate(
+        [&, this]() {
+            // iterated state estimation
+            double solve_H_time = 0;
+            // update the observation model, will call nn and point-to-plane residual computation
+            kf_.update_iterated_dyn_share_modified(
+                options::LASER_POINT_COV, solve_H_time,
+                [this](state_ikfom &s, esekfom::dyn_share_datastruct<double> &ekfom_data) { ObsModel(s, ekfom_data); },
+                obs_data_);
+            // save the state
+            state_point_ = kf_.get_x();
+        },
+        "IEKF Solve and Update");
+
+    // update local map
+    timer_.Evaluate([&, this]() { MapIncremental(); }, "    Incremental Mapping");
+
+    metric_.frames_->Inc();
+    metric_.effective_features_->Set(effect_feat_num_);
+    metric_.iekf_iterations_->Observe(obs_iter_);
+    metric_.map_voxels_->Set(ivox_->NumValidGrids());
+    metric_.map_points_->Set(ivox_->NumPoints());
+    SetTrackState(effect_feat_num_ < 1 ? TrackState::DEGENERATE : TrackState::TRACKING);
+    UpdateMemoryAccount();
+    return true;
+}
+
+void LioCore::UpdateMemoryAccount() {
+    const auto cloud_bytes = [](const CloudPtr &cloud) {
+        return cloud == nullptr ? 0 : cloud->points.capacity() * sizeof(PointType);
+    };
+    const auto vector_bytes = [](const auto &v) { return v.capacity() * sizeof(v[0]); };
+
+    memory_.Set("map_voxels", ivox_pyramid_->VoxelBytes());
+    memory_.Set("map_points", ivox_pyramid_->PointBytes());
+    memory_.Set("scan_buffers", cloud_bytes(measures_.lidar_) + cloud_bytes(scan_undistort_) +
+                                    cloud_bytes(scan_down_body_) + cloud_bytes(scan_down_world_) +
+                                    vector_bytes(nearest_points_) + vector_bytes(num_nearest_) +
+                                    vector_bytes(residuals_) + vector_bytes(weights_) + vector_bytes(noise_weights_) +
+                                    vector_bytes(block_offsets_) + vector_bytes(map_add_flags_) +
+                                    vector_bytes(point_selected_surf_) + vector_bytes(plane_coef_) +
+                                    vector_bytes(points_to_add_) + vector_bytes(points_no_need_downsample_) +
+                                    (obs_data_.h_x_T.size() + obs_data_.h.size() + obs_data_.weight.size()) *
+                                        sizeof(double));
+    memory_.Set("input_queues", queue_bytes_);
+
+    const auto now = std::chrono::steady_clock::now();
+    if (options_.memory_report_interval_ > 0 &&
+        std::chrono::duration<double>(now - last_memory_report_).count() >= options_.memory_report_interval_) {
+        memory_.Report();
+        last_memory_report_ = now;
+    }
+}
+
+void LioCore::PrepareScanBuffers(int cur_pts) {
+    scan_down_world_->resize(cur_pts);
+    nearest_points_.resize(cur_pts * options::NUM_MATCH_POINTS);
+    num_nearest_.resize(cur_pts, 0);
+    residuals_.resize(cur_pts * RowsPerPoint(), 0);
+    weights_.resize(cur_pts * RowsPerPoint(), 1.0);
+    noise_weights_.resize(cur_pts * RowsPerPoint(), 1.0);
+    point_selected_surf_.resize(cur_pts, true);
+    plane_coef_.resize(cur_pts * RowsPerPoint(), common::V4F::Zero());
+    obs_iter_ = 0;
+
+    // the update uses the first effect_feat_num_ columns, only a larger frame than any before allocates
+    const int max_rows = cur_pts * RowsPerPoint();
+    if (obs_data_.h_x_T.cols() < max_rows) {
+        obs_data_.h_x_T.resize(12, max_rows);
+        obs_data_.h.resize(max_rows);
+        obs_data_.weight.resize(max_rows);
+    }
+}
+
+void LioCore::SetMapAndScan(const PointVector &map_points, const PointVector &scan_body) {
+    ivox_pyramid_->Reset();
+    ivox_pyramid_->AddPoints(map_points);
+    scan_down_body_->points.assign(scan_body.begin(), scan_body.end());
+    scan_down_body_->width = scan_down_body_->points.size();
+    scan_down_body_->height = 1;
+    PrepareScanBuffers(scan_down_body_->size());
+}
+
+bool LioCore::SyncPackages() {
+    auto lock = TracedLock(mtx_buffer_, &tracer_, "wait mtx_buffer_");
+    if (lidar_buffer_.empty() || imu_buffer_.empty()) {
+        return false;
+    }
+
+    /*** push a lidar scan ***/
+    if (!lidar_pushed_) {
+        measures_.lidar_ = lidar_buffer_.front();
+        measures_.lidar_bag_time_ = time_buffer_.front();
+
+        if (measures_.lidar_->points.size() <= 1) {
+            LOG(WARNING) << "Too few input point cloud!";
+            lidar_end_time_ = measures_.lidar_bag_time_ + lidar_mean_scantime_;
+        } else if (measures_.lidar_->points.back().curvature / double(1000) < 0.5 * lidar_mean_scantime_) {
+            lidar_end_time_ = measures_.lidar_bag_time_ + lidar_mean_scantime_;
+        } else {
+            scan_num_++;
+            lidar_end_time_ = measures_.lidar_bag_time_ + measures_.lidar_->points.back().curvature / double(1000);
+            lidar_mean_scantime_ +=
+                (measures_.lidar_->points.back().curvature / double(1000) - lidar_mean_scantime_) / scan_num_;
+        }
+
+        measures_.lidar_end_time_ = lidar_end_time_;
+        lidar_pushed_ = true;
+    }
+
+    if (last_timestamp_imu_ < lidar_end_time_) {
+        return false;
+    }
+
+    /*** push imu_ data, and pop from imu_ buffer ***/
+    double imu_time = imu_buffer_.front().timestamp_;
+    measures_.imu_.clear();
+    while ((!imu_buffer_.empty()) && (imu_time < lidar_end_time_)) {
+        imu_time = imu_buffer_.front().timestamp_;
+        if (imu_time > lidar_end_time_) break;
+        measures_.imu_.push_back(imu_buffer_.front());
+        imu_buffer_.pop_front();
+    }
+
+    lidar_buffer_bytes_ -= lidar_buffer_.front()->points.capacity() * sizeof(PointType);
+    lidar_buffer_.pop_front();
+    time_buffer_.pop_front();
+    lidar_pushed_ = false;
+    queue_bytes_ = lidar_buffer_bytes_ + imu_buffer_.size() * sizeof(common::ImuData);
+    metric_.lidar_queue_->Set(lidar_buffer_.size());
+    metric_.imu_queue_->Set(imu_buffer_.size());
+    return true;
+}
+
+void LioCore::WriteTumPose(std::ostream &os) const {
+    os << std::fixed << std::setprecision(6) << lidar_end_time_ << " " << std::setprecision(15) << state_point_.pos.x()
+       << " " << state_point_.pos.y() << " " << state_point_.pos.z() << " " << state_point_.rot.coeffs()[0] << " "
+       << state_point_.rot.coeffs()[1] << " " << state_point_.rot.coeffs()[2] << " " << state_point_.rot.coeffs()[3]
+       << std::endl;
+}
+
+PointType LioCore::PointBodyToWorld(const PointType &pi) const {
+    common::V3D p_body(pi.x, pi.y, pi.z);
+    common::V3D p_global(state_point_.rot * (state_point_.offset_R_L_I * p_body + state_point_.offset_T_L_I) +
+                         state_point_.pos);
+    PointType po;
+    po.x = p_global(0);
+    po.y = p_global(1);
+    po.z = p_global(2);
+    po.intensity = pi.intensity;
+    return po;
+}
+
+void LioCore::PointBodyLidarToIMU(PointType const *const pi, PointType *const po) const {
+    common::V3D p_body_lidar(pi->x, pi->y, pi->z);
+    common::V3D p_body_imu(state_point_.offset_R_L_I * p_body_lidar + state_point_.offset_T_L_I);
+
+    po->x = p_body_imu(0);
+    po->y = p_body_imu(1);
+    po->z = p_body_imu(2);
+    po->intensity = pi->intensity;
+}
+
+uint8_t LioCore::MapAddFlag(const PointType &point_world, const PointType *points_near, int num_near) const {
+    if (num_near == 0 || !flg_EKF_inited_) {
+        return ADD_DOWNSAMPLE;
+    }
+
+    const double filter_size_map = options_.filter_size_map_;
+    Eigen::Vector3f center =
+        ((point_world.getVector3fMap() / filter_size_map).array().floor() + 0.5) * filter_size_map;
+
+    Eigen::Vector3f dis_2_center = points_near[0].getVector3fMap() - center;
+
+    if (fabs(dis_2_center.x()) > 0.5 * filter_size_map && fabs(dis_2_center.y()) > 0.5 * filter_size_map &&
+        fabs(dis_2_center.z()) > 0.5 * filter_size_map) {
+        return ADD_NO_DOWNSAMPLE;
+    }
+
+    float dist = common::calc_dist(point_world.getVector3fMap(), center);
+    if (num_near >= options::NUM_MATCH_POINTS) {
+        for (int readd_i = 0; readd_i < options::NUM_MATCH_POINTS; readd_i++) {
+            if (common::calc_dist(points_near[readd_i].getVector3fMap(), center) < dist + 1e-6) {
+                return NOT_ADD;
+            }
+        }
+    }
+    return ADD_DOWNSAMPLE;
+}
+
+void LioCore::MapIncremental() {
+    int cur_pts = scan_down_body_->size();
+    points_to_add_.clear();
+    points_no_need_downsample_.clear();
+
+    // decide in parallel, gather in order, the map itself is not thread safe
+    map_add_flags_.resize(cur_pts);
+    arena_->ParallelFor(0, cur_pts, map_partitioner_, [&](const tbb::blocked_range<int> &r) {
+        for (int i = r.begin(); i < r.end(); ++i) {
+            /* transform to world frame */
+            scan_down_world_->points[i] = PointBodyToWorld(scan_down_body_->points[i]);
+
+            /* decide if need add to map */
+            const PointType &point_world = scan_down_world_->points[i];
+            PointType *points_near = &nearest_points_[i * options::NUM_MATCH_POINTS];
+            if (options_.residual_type_ == common::ResidualType::POINT_TO_DISTRIBUTION && flg_EKF_inited_) {
+                // the distribution residual does not search neighbours, do it once here for the downsample check
+                num_nearest_[i] = ivox_->GetClosestPoint(point_world, points_near, options::NUM_MATCH_POINTS);
+            }
+            map_add_flags_[i] = MapAddFlag(point_world, points_near, num_nearest_[i]);
+        }
+    });
+
+    for (int i = 0; i < cur_pts; ++i) {
+        if (map_add_flags_[i] == ADD_DOWNSAMPLE) {
+            points_to_add_.emplace_back(scan_down_world_->points[i]);
+        } else if (map_add_flags_[i] == ADD_NO_DOWNSAMPLE) {
+            points_no_need_downsample_.emplace_back(scan_down_world_->points[i]);
+        }
+    }
+
+    timer_.Evaluate(
+        [&, this]() {
+            ivox_pyramid_->AddPoints(points_to_add_);
+            ivox_pyramid_->AddPoints(points_no_need_downsample_);
+        },
+        "    IVox Add Points");
+}
+
+/**
+ * Lidar point cloud registration
+ * will be called by the eskf custom observation model
+ * compute point-to-plane residual here
+ * @param s kf state
+ * @param ekfom_data H matrix
+ */
+void LioCore::ObsModel(state_ikfom &s, esekfom::dyn_share_datastruct<double> &ekfom_data) {
+    int cnt_pts = scan_down_body_->size();
+
+    // coarse-to-fine: the first iterations match against the coarse levels, search again whenever the level changes
+    const int level = ivox_pyramid_->LevelAtIteration(obs_iter_++, options_.max_iterations_);
+    const bool search = ekfom_data.converge || level != match_level_;
+    const auto &ivox = ivox_pyramid_->Level(level);
+    const float plane_threshold =
+        options_.esti_plane_threshold_ * ivox_pyramid_->Resolution(level) / ivox_pyramid_->Resolution(0);
+    match_level_ = level;
+    ekfom_data.coarse = level > 0;
+
+    timer_.Evaluate(
+        [&, this]() {
+            auto R_wl = (s.rot * s.offset_R_L_I).cast<float>();
+            auto t_wl = (s.rot * s.offset_T_L_I + s.pos).cast<float>();
+
+            arena_->ParallelFor(0, cnt_pts, match_partitioner_, [&](const tbb::blocked_range<int> &r) {
+                for (auto i = r.begin(); i < r.end(); ++i) {
+                    // TODO: these non const should die
+                    const PointType &point_body = scan_down_body_->points[i];
+
+                    /* transform to world frame */
+                    common::V3F p_body = point_body.getVector3fMap();
+                    PointType point_world = PointType();
+                    point_world.getVector3fMap() = R_wl * p_body + t_wl;
+                    point_world.intensity = point_body.intensity;
+                    scan_down_world_->points[i] = point_world;
+
+                    if (options_.residual_type_ == common::ResidualType::POINT_TO_DISTRIBUTION) {
+                        if (search) {
+                            /** Gaussian of the voxel, one row per principal axis **/
+                            common::V3F mean;
+                            common::M3F cov;
+                            point_selected_surf_[i] =
+                                ivox->GetDistribution(point_world, mean, cov, options::MIN_NUM_MATCH_POINTS);
+                            if (point_selected_surf_[i]) {
+                                float var[3];
+                                common::distribution_to_planes(mean, cov, options_.distribution_min_variance_,
+                                                               &plane_coef_[3 * i], var);
+                                for (int k = 0; k < 3; k++) {
+                                    noise_weights_[3 * i + k] = options::LASER_POINT_COV / var[k];
+                                }
+                            }
+                        }
+
+                        if (point_selected_surf_[i]) {
+                            auto temp = point_world.getVector4fMap();
+                            temp[3] = 1.0;
+                            float mahalanobis2 = 0;
+                            for (int k = 0; k < 3; k++) {
+                                const int row = 3 * i + k;
+                                const float pd = plane_coef_[row].dot(temp);
+                                residuals_[row] = pd;
+                                weights_[row] =
+                                    common::robust_weight(options_.robust_kernel_, pd, options_.robust_kernel_delta_) *
+                                    noise_weights_[row];
+                                mahalanobis2 += pd * pd * noise_weights_[row] / options::LASER_POINT_COV;
+                            }
+                            point_selected_surf_[i] = mahalanobis2 < options_.distribution_max_mahalanobis2_;
+                        }
+                        continue;
+                    }
+
+                    if (search) {
+                        /** Find the closest surfaces in the map **/
+                        PointType *points_near = &nearest_points_[i * options::NUM_MATCH_POINTS];
+                        const int num_near =
+                            ivox->GetClosestPoint(point_world, points_near, options::NUM_MATCH_POINTS);
+                        num_nearest_[i] = num_near;
+                        point_selected_surf_[i] = num_near >= options::MIN_NUM_MATCH_POINTS;
+                        if (point_selected_surf_[i]) {
+                            point_selected_surf_[i] =
+                                common::esti_plane(plane_coef_[i], points_near, num_near, plane_threshold);
+                        }
+                        if (point_selected_surf_[i] && options_.point_cov_en_) {
+                            float var =
+                                common::point_plane_variance(R_wl * p_body, plane_coef_[i], points_near, num_near,
+                                                             options_.range_sigma_, options_.bearing_sigma_);
+                            noise_weights_[i] = options::LASER_POINT_COV / std::max(var, 1e-6f);
+                        }
+                    }
+
+                    if (point_selected_surf_[i]) {
+                        auto temp = point_world.getVector4fMap();
+                        temp[3] = 1.0;
+                        float pd2 = plane_coef_[i].dot(temp);
+
+                        bool valid_corr = p_body.norm() > 81 * pd2 * pd2;
+                        if (valid_corr) {
+                            point_selected_surf_[i] = true;
+                            residuals_[i] = pd2;
+                            weights_[i] =
+                                common::robust_weight(options_.robust_kernel_, pd2, options_.robust_kernel_delta_) *
+                                (options_.point_cov_en_ ? noise_weights_[i] : 1.0f);
+                        } else {
+                            // residuals_[i] and weights_[i] still hold an older iteration, or another point
+                            point_selected_surf_[i] = false;
+                        }
+                    }
+                }
+            });
+        },
+        "    ObsModel (Lidar Match)");
+
+    // select and compact: count the residual rows of every block of points, the prefix sum over the blocks gives each
+    // block its first output column, so the jacobian is written in parallel straight from the per-point results.
+    // every row shares the point-to-plane jacobian, the distribution residual has one row per axis
+    const int rows = RowsPerPoint();
+    const int block_size = arena_->GrainSize();
+    const int num_blocks = (cnt_pts + block_size - 1) / block_size;
+    block_offsets_.assign(num_blocks + 1, 0);
+    arena_->ParallelFor(0, num_blocks, 1, count_partitioner_, [&](const tbb::blocked_range<int> &r) {
+        for (int b = r.begin(); b < r.end(); ++b) {
+            const int end = std::min(cnt_pts, (b + 1) * block_size);
+            int cnt = 0;
+            for (int i = b * block_size; i < end; ++i) {
+                cnt += point_selected_surf_[i] ? rows : 0;
+            }
+            block_offsets_[b + 1] = cnt;
+        }
+    });
+    std::partial_sum(block_offsets_.begin(), block_offsets_.end(), block_offsets_.begin());
+    effect_feat_num_ = block_offsets_.back();
+
+    if (effect_feat_num_ < 1) {
+        ekfom_data.valid = false;
+        LOG(WARNING) << "No Effective Points!";
+        return;
+    }
+
+    timer_.Evaluate(
+        [&, this]() {
+            /*** Computation of Measurement Jacobian matrix H and measurements vector ***/
+            // column-major 12 x n, every measurement is one contiguous column, no zero fill needed
+            // the buffers are sized in PrepareScanBuffers, the update reads the first effect_feat_num_ columns
+            if (ekfom_data.h_x_T.cols() < effect_feat_num_) {
+                // a caller with its own data, e.g. the benchmarks
+                ekfom_data.h_x_T.resize(12, cnt_pts * rows);
+                ekfom_data.h.resize(cnt_pts * rows);
+                ekfom_data.weight.resize(cnt_pts * rows);
+            }
+            ekfom_data.dof = effect_feat_num_;
+
+            const common::M3F off_R = s.offset_R_L_I.toRotationMatrix().cast<float>();
+            const common::V3F off_t = s.offset_T_L_I.cast<float>();
+            const common::M3F Rt = s.rot.toRotationMatrix().transpose().cast<float>();
+
+            arena_->ParallelFor(0, num_blocks, 1, jacobian_partitioner_, [&](const tbb::blocked_range<int> &r) {
+                for (int b = r.begin(); b < r.end(); ++b) {
+                    const int end = std::min(cnt_pts, (b + 1) * block_size);
+                    int col = block_offsets_[b];
+                    for (int i = b * block_size; i < end; ++i) {
+                        if (!point_selected_surf_[i]) {
+                            continue;
+                        }
+
+                        common::V3F point_this_be = scan_down_body_->points[i].getVector3fMap();
+                        common::M3F point_be_crossmat = SKEW_SYM_MATRIX(point_this_be);
+                        common::V3F point_this = off_R * point_this_be + off_t;
+                        common::M3F point_crossmat = SKEW_SYM_MATRIX(point_this);
+
+                        for (int row = i * rows; row < (i + 1) * rows; ++row, ++col) {
+                            /*** get the normal vector of closest surface/corner ***/
+                            common::V3F norm_vec = plane_coef_[row].head<3>();
+
+                            /*** calculate the Measurement Jacobian matrix H ***/
+                            common::V3F C(Rt * norm_vec);
+                            common::V3F A(point_crossmat * C);
+
+                            auto h_col = ekfom_data.h_x_T.col(col);
+                            h_col.head<3>() = norm_vec.cast<double>();
+                            h_col.segment<3>(3) = A.cast<double>();
+                            if (options_.extrinsic_est_en_) {
+                                common::V3F B(point_be_crossmat * off_R.transpose() * C);
+                                h_col.segment<3>(6) = B.cast<double>();
+                                h_col.segment<3>(9) = C.cast<double>();
+                            } else {
+                                h_col.tail<6>().setZero();
+                            }
+
+                            /*** Measurement: distance to the closest surface/corner ***/
+                            ekfom_data.h(col) = -residuals_[row];
+
+                            /*** robust and per-point noise weight, R / R_i ***/
+                            ekfom_data.weight(col) = weights_[row];
+                        }
+                    }
+                }
+            });
+        },
+        "    ObsModel (IEKF Build Jacobian)");
+}
+
+}  // namespace faster_lio
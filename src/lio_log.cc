@@ -0,0 +1,226 @@
+#include "lio_log.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#include "lio_core.h"
+
+namespace faster_lio {
+
+namespace {
+const char *const kColumnNames[] = {"imu_time",  "imu_acc",   "imu_gyro",        "scan_time",
+                                    "scan_end",  "point_xyz", "point_intensity", "point_time"};
+
+template <typename T>
+void WriteColumn(std::ofstream &out, const T *data, size_t num) {
+    out.write(reinterpret_cast<const char *>(data), num * sizeof(T));
+}
+}  // namespace
+
+bool LioLogWriter::Open(const std::string &dir) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        LOG(ERROR) << "cannot create log dir " << dir << ": " << ec.message();
+        return false;
+    }
+
+    dir_ = dir;
+    header_ = lio_log::LogHeader();
+    std::memcpy(header_.magic_, lio_log::kMagic, sizeof(lio_log::kMagic));
+    for (int c = 0; c < NUM; ++c) {
+        columns_[c].open(dir_ + "/" + kColumnNames[c], std::ios::binary | std::ios::trunc);
+        if (!columns_[c]) {
+            LOG(ERROR) << "cannot open " << dir_ << "/" << kColumnNames[c];
+            return false;
+        }
+    }
+
+    // an old header would describe the truncated columns, remove it until Close() writes the new one
+    std::filesystem::remove(dir_ + "/header", ec);
+    opened_ = true;
+    return true;
+}
+
+void LioLogWriter::AddImu(const common::ImuData &imu) {
+    WriteColumn(columns_[IMU_TIME], &imu.timestamp_, 1);
+    WriteColumn(columns_[IMU_ACC], imu.acc_.data(), 3);
+    WriteColumn(columns_[IMU_GYRO], imu.gyro_.data(), 3);
+    header_.num_imu_++;
+}
+
+void LioLogWriter::AddScan(double timestamp, const PointCloudType &scan) {
+    const size_t num = scan.size();
+    xyz_.resize(3 * num);
+    intensity_.resize(num);
+    time_.resize(num);
+    for (size_t i = 0; i < num; ++i) {
+        const auto &pt = scan.points[i];
+        xyz_[3 * i] = pt.x;
+        xyz_[3 * i + 1] = pt.y;
+        xyz_[3 * i + 2] = pt.z;
+        intensity_[i] = pt.intensity;
+        time_[i] = pt.curvature;
+    }
+
+    header_.num_points_ += num;
+    header_.num_scans_++;
+    const uint64_t end = header_.num_points_;
+    WriteColumn(columns_[SCAN_TIME], &timestamp, 1);
+    WriteColumn(columns_[SCAN_END], &end, 1);
+    WriteColumn(columns_[POINT_XYZ], xyz_.data(), xyz_.size());
+    WriteColumn(columns_[POINT_INTENSITY], intensity_.data(), num);
+    WriteColumn(columns_[POINT_TIME], time_.data(), num);
+}
+
+bool LioLogWriter::Close() {
+    if (!opened_) {
+        return true;
+    }
+    opened_ = false;
+
+    bool good = true;
+    for (auto &column : columns_) {
+        column.close();
+        good = good && !column.fail();
+    }
+
+    std::ofstream fout(dir_ + "/header", std::ios::binary | std::ios::trunc);
+    fout.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+    fout.close();
+    if (!good || fout.fail()) {
+        LOG(ERROR) << "failed to write log " << dir_;
+        return false;
+    }
+
+    LOG(INFO) << "log " << dir_ << ": " << header_.num_scans_ << " scans, " << header_.num_points_ << " points, "
+              << header_.num_imu_ << " imu samples";
+    return true;
+}
+
+LioLogReader::~LioLogReader() {
+    for (const auto &m : maps_) {
+        munmap(m.first, m.second);
+    }
+}
+
+template <typename T>
+bool LioLogReader::Map(const std::string &path, size_t num, const T *&data) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "cannot open " << path;
+        return false;
+    }
+
+    struct stat st {};
+    fstat(fd, &st);
+    if (static_cast<size_t>(st.st_size) != num * sizeof(T)) {
+        LOG(ERROR) << path << " has " << st.st_size << " bytes, expect " << num * sizeof(T);
+        close(fd);
+        return false;
+    }
+
+    data = nullptr;
+    if (num > 0) {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            LOG(ERROR) << "cannot map " << path;
+            close(fd);
+            return false;
+        }
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);  // replay reads every column front to back
+        maps_.emplace_back(addr, st.st_size);
+        data = static_cast<const T *>(addr);
+    }
+    close(fd);
+    return true;
+}
+
+bool LioLogReader::Open(const std::string &dir) {
+    std::ifstream fin(dir + "/header", std::ios::binary);
+    if (!fin.read(reinterpret_cast<char *>(&header_), sizeof(header_)) ||
+        std::memcmp(header_.magic_, lio_log::kMagic, sizeof(lio_log::kMagic)) != 0) {
+        LOG(ERROR) << dir << " is not a complete faster-lio log";
+        return false;
+    }
+    if (header_.version_ != lio_log::kVersion) {
+        LOG(ERROR) << "log version " << header_.version_ << " is not supported, expect " << lio_log::kVersion;
+        return false;
+    }
+
+    const std::string prefix = dir + "/";
+    return Map(prefix + "imu_time", NumImu(), imu_time_) && Map(prefix + "imu_acc", 3 * NumImu(), imu_acc_) &&
+           Map(prefix + "imu_gyro", 3 * NumImu(), imu_gyro_) && Map(prefix + "scan_time", NumScans(), scan_time_) &&
+           Map(prefix + "scan_end", NumScans(), scan_end_) && Map(prefix + "point_xyz", 3 * NumPoints(), point_xyz_) &&
+           Map(prefix + "point_intensity", NumPoints(), point_intensity_) &&
+           Map(prefix + "point_time", NumPoints(), point_time_);
+}
+
+common::ImuData LioLogReader::Imu(size_t i) const {
+    common::ImuData imu;
+    imu.timestamp_ = imu_time_[i];
+    imu.acc_ = Eigen::Map<const common::V3D>(imu_acc_ + 3 * i);
+    imu.gyro_ = Eigen::Map<const common::V3D>(imu_gyro_ + 3 * i);
+    return imu;
+}
+
+void LioLogReader::GetScan(size_t i, PointCloudType &scan) const {
+    const size_t begin = ScanBegin(i), num = ScanSize(i);
+    scan.resize(num);
+    for (size_t k = 0; k < num; ++k) {
+        auto &pt = scan.points[k];
+        pt.getVector3fMap() = Eigen::Map<const common::V3F>(point_xyz_ + 3 * (begin + k));
+        pt.intensity = point_intensity_[begin + k];
+        pt.curvature = point_time_[begin + k];
+    }
+}
+
+double LioLogReader::ScanEndTime(size_t i) const {
+    const size_t begin = ScanBegin(i), end = scan_end_[i];
+    const float max_time = begin == end ? 0 : *std::max_element(point_time_ + begin, point_time_ + end);
+    return ScanTime(i) + max_time / double(1000);
+}
+
+size_t LioLogReader::Replay(LioCore &core, const std::function<bool(bool)> &on_scan) const {
+    size_t imu_index = 0;
+    for (size_t i = 0; i < NumScans(); ++i) {
+        // a scan is processed once the imu covers its end, up to the first sample at or after it
+        const double scan_end = ScanEndTime(i);
+        for (; imu_index < NumImu() && (imu_index == 0 || imu_time_[imu_index - 1] < scan_end); ++imu_index) {
+            core.AddImu(Imu(imu_index));
+        }
+
+        bool processed = false;
+        core.GetTimer().Evaluate(
+            [&]() {
+                CloudPtr scan = core.GetCloudPool().Acquire();
+                GetScan(i, *scan);
+                core.AddScan(ScanTime(i), scan);
+                processed = core.Run();
+            },
+            "Laser Mapping Single Run");
+        if (!on_scan(processed)) {
+            return i + 1;
+        }
+    }
+
+    // the trailing imu, for the scans the core ends later than their points, e.g. with the mean scan time
+    for (; imu_index < NumImu(); ++imu_index) {
+        core.AddImu(Imu(imu_index));
+    }
+    for (bool processed = true; processed;) {
+        core.GetTimer().Evaluate([&]() { processed = core.Run(); }, "Laser Mapping Single Run");
+        if (processed && !on_scan(processed)) {
+            break;
+        }
+    }
+    return NumScans();
+}
+
+}  // namespace faster_lio
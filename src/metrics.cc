@@ -0,0 +1,202 @@
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+namespace faster_lio {
+
+namespace {
+const char *TypeName(int type) {
+    static const char *const kNames[] = {"counter", "gauge", "histogram"};
+    return kNames[type];
+}
+
+/// prefix and label set of one sample
+std::string Sample(const std::string &name, const std::string &labels) {
+    return "faster_lio_" + name + (labels.empty() ? "" : "{" + labels + "}");
+}
+}  // namespace
+
+MetricsRegistry::Histogram::Histogram(std::vector<double> bounds) : bounds_(std::move(bounds)) {
+    std::sort(bounds_.begin(), bounds_.end());
+    counts_.reset(new std::atomic<uint64_t>[bounds_.size() + 1]);
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        counts_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricsRegistry::Histogram::Observe(double value) {
+    const size_t bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+
+    // no fetch_add for atomic<double> before c++20, a single writer never retries
+    double sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {
+    }
+}
+
+MetricsRegistry::Counter &MetricsRegistry::AddCounter(const std::string &name, const std::string &help,
+                                                      const std::string &labels) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    counters_.emplace_back();
+    entries_.push_back({name, help, labels, Type::COUNTER, &counters_.back()});
+    return counters_.back();
+}
+
+MetricsRegistry::Gauge &MetricsRegistry::AddGauge(const std::string &name, const std::string &help,
+                                                  const std::string &labels) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    gauges_.emplace_back();
+    entries_.push_back({name, help, labels, Type::GAUGE, &gauges_.back()});
+    return gauges_.back();
+}
+
+MetricsRegistry::Histogram &MetricsRegistry::AddHistogram(const std::string &name, const std::string &help,
+                                                          std::vector<double> bounds, const std::string &labels) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    histograms_.emplace_back(std::move(bounds));
+    entries_.push_back({name, help, labels, Type::HISTOGRAM, &histograms_.back()});
+    return histograms_.back();
+}
+
+std::string MetricsRegistry::Serialize() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // the exposition format wants the samples of a name next to each other
+    std::vector<const Entry *> entries;
+    for (const auto &e : entries_) {
+        entries.emplace_back(&e);
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const Entry *a, const Entry *b) { return a->name_ < b->name_; });
+
+    std::ostringstream oss;
+    oss << std::setprecision(15);  // byte counts stay exact
+    std::set<std::string> described;
+    for (const Entry *e : entries) {
+        if (described.insert(e->name_).second) {
+            oss << "# HELP faster_lio_" << e->name_ << " " << e->help_ << "\n";
+            oss << "# TYPE faster_lio_" << e->name_ << " " << TypeName(static_cast<int>(e->type_)) << "\n";
+        }
+
+        if (e->type_ == Type::COUNTER) {
+            oss << Sample(e->name_, e->labels_) << " " << static_cast<const Counter *>(e->metric_)->Value() << "\n";
+        } else if (e->type_ == Type::GAUGE) {
+            oss << Sample(e->name_, e->labels_) << " " << static_cast<const Gauge *>(e->metric_)->Value() << "\n";
+        } else {
+            const auto *h = static_cast<const Histogram *>(e->metric_);
+            const std::string sep = e->labels_.empty() ? "" : ",";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i <= h->bounds_.size(); ++i) {
+                cumulative += h->counts_[i].load(std::memory_order_relaxed);
+                std::ostringstream le;
+                if (i < h->bounds_.size()) {
+                    le << h->bounds_[i];
+                } else {
+                    le << "+Inf";
+                }
+                oss << Sample(e->name_ + "_bucket", e->labels_ + sep + "le=\"" + le.str() + "\"") << " " << cumulative
+                    << "\n";
+            }
+            oss << Sample(e->name_ + "_sum", e->labels_) << " " << h->sum_.load(std::memory_order_relaxed) << "\n";
+            oss << Sample(e->name_ + "_count", e->labels_) << " " << h->count_.load(std::memory_order_relaxed)
+                << "\n";
+        }
+    }
+    return oss.str();
+}
+
+bool MetricsServer::Start(int port) {
+    Stop();
+
+    fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        LOG(ERROR) << "cannot create the metrics socket";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd_, 4) != 0) {
+        LOG(ERROR) << "cannot listen on port " << port << " for metrics: " << std::strerror(errno);
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { Serve(); });
+    LOG(INFO) << "metrics at http://127.0.0.1:" << port << "/metrics";
+    return true;
+}
+
+void MetricsServer::Stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+void MetricsServer::Serve() {
+    while (running_) {
+        // wake up now and then to notice Stop()
+        pollfd pfd{fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        int client = accept(fd_, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+
+        // a silent client must not hold up Stop()
+        timeval timeout{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        // only the request line matters, the rest of the header is ignored
+        char request[1024];
+        const ssize_t len = recv(client, request, sizeof(request) - 1, 0);
+        request[std::max<ssize_t>(len, 0)] = '\0';
+
+        std::string status = "200 OK", body;
+        if (std::strncmp(request, "GET /metrics", 12) == 0) {
+            body = registry_.Serialize();
+        } else {
+            status = "404 Not Found";
+        }
+
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status << "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                 << body.size() << "\r\nConnection: close\r\n\r\n"
+                 << body;
+        const std::string out = response.str();
+        for (size_t sent = 0; sent < out.size();) {
+            const ssize_t n = send(client, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        close(client);
+    }
+}
+
+}  // namespace faster_lio
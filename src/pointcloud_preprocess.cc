@@ -4,14 +4,42 @@
 
 namespace faster_lio {
 
-void PointCloudPreprocess::Set(LidarType lid_type, double bld, int pfilt_num) {
-    lidar_type_ = lid_type;
-    blind_ = bld;
-    point_filter_num_ = pfilt_num;
+bool PointCloudPreprocess::LoadOptions(const YAML::Node &yaml, Options &options) {
+    int lidar_type;
+    try {
+        options.blind_ = yaml["preprocess"]["blind"].as<double>();
+        options.time_scale_ = yaml["preprocess"]["time_scale"].as<double>();
+        lidar_type = yaml["preprocess"]["lidar_type"].as<int>();
+        options.num_scans_ = yaml["preprocess"]["scan_line"].as<int>();
+        options.point_filter_num_ = yaml["point_filter_num"].as<int>();
+        options.feature_enabled_ = yaml["feature_extract_enable"].as<bool>();
+    } catch (...) {
+        LOG(ERROR) << "bad conversion";
+        return false;
+    }
+    return options.SetLidarType(lidar_type);
+}
+
+bool PointCloudPreprocess::Options::SetLidarType(int lidar_type) {
+    LOG(INFO) << "lidar_type " << lidar_type;
+    if (lidar_type == 1) {
+        lidar_type_ = LidarType::AVIA;
+        LOG(INFO) << "Using AVIA Lidar";
+    } else if (lidar_type == 2) {
+        lidar_type_ = LidarType::VELO32;
+        LOG(INFO) << "Using Velodyne 32 Lidar";
+    } else if (lidar_type == 3) {
+        lidar_type_ = LidarType::OUST64;
+        LOG(INFO) << "Using OUST 64 Lidar";
+    } else {
+        LOG(WARNING) << "unknown lidar_type";
+        return false;
+    }
+    return true;
 }
 
 void PointCloudPreprocess::Process(const sensor_msgs::PointCloud2::ConstPtr &msg, PointCloudType::Ptr &pcl_out) {
-    switch (lidar_type_) {
+    switch (options_.lidar_type_) {
         case LidarType::OUST64:
             Oust64Handler(msg);
             break;
@@ -28,21 +56,28 @@ void PointCloudPreprocess::Process(const sensor_msgs::PointCloud2::ConstPtr &msg
 }
 
 
+template <typename PointT>
+void PointCloudPreprocess::FromMsg(const sensor_msgs::PointCloud2 &msg, pcl::PointCloud<PointT> &cloud) {
+    // pcl::fromROSMsg goes through a temporary copy of the message data
+    pcl_conversions::toPCL(msg, msg_cloud_);
+    pcl::fromPCLPointCloud2(msg_cloud_, cloud);
+}
+
 void PointCloudPreprocess::Oust64Handler(const sensor_msgs::PointCloud2::ConstPtr &msg) {
     cloud_out_.clear();
     cloud_full_.clear();
-    pcl::PointCloud<ouster_ros::Point> pl_orig;
-    pcl::fromROSMsg(*msg, pl_orig);
+    auto &pl_orig = ouster_cloud_;
+    FromMsg(*msg, pl_orig);
     int plsize = pl_orig.size();
     cloud_out_.reserve(plsize);
 
     for (int i = 0; i < pl_orig.points.size(); i++) {
-        if (i % point_filter_num_ != 0) continue;
+        if (i % options_.point_filter_num_ != 0) continue;
 
         double range = pl_orig.points[i].x * pl_orig.points[i].x + pl_orig.points[i].y * pl_orig.points[i].y +
                        pl_orig.points[i].z * pl_orig.points[i].z;
 
-        if (range < (blind_ * blind_)) continue;
+        if (range < (options_.blind_ * options_.blind_)) continue;
 
         Eigen::Vector3d pt_vec;
         PointType added_pt;
@@ -63,17 +98,17 @@ void PointCloudPreprocess::VelodyneHandler(const sensor_msgs::PointCloud2::Const
     cloud_out_.clear();
     cloud_full_.clear();
 
-    pcl::PointCloud<velodyne_ros::Point> pl_orig;
-    pcl::fromROSMsg(*msg, pl_orig);
+    auto &pl_orig = velodyne_cloud_;
+    FromMsg(*msg, pl_orig);
     int plsize = pl_orig.points.size();
     cloud_out_.reserve(plsize);
 
     /*** These variables only works when no point timestamps given ***/
     double omega_l = 3.61;  // scan angular velocity
-    std::vector<bool> is_first(num_scans_, true);
-    std::vector<double> yaw_fp(num_scans_, 0.0);    // yaw of first scan point
-    std::vector<float> yaw_last(num_scans_, 0.0);   // yaw of last scan point
-    std::vector<float> time_last(num_scans_, 0.0);  // last offset time
+    is_first_.assign(options_.num_scans_, true);
+    yaw_fp_.assign(options_.num_scans_, 0.0);
+    yaw_last_.assign(options_.num_scans_, 0.0);
+    time_last_.assign(options_.num_scans_, 0.0);
     /*****************************************************************/
 
     if (pl_orig.points[plsize - 1].time > 0) {
@@ -101,36 +136,37 @@ void PointCloudPreprocess::VelodyneHandler(const sensor_msgs::PointCloud2::Const
         added_pt.y = pl_orig.points[i].y;
         added_pt.z = pl_orig.points[i].z;
         added_pt.intensity = pl_orig.points[i].intensity;
-        added_pt.curvature = pl_orig.points[i].time * time_scale_;  // curvature unit: ms
+        added_pt.curvature = pl_orig.points[i].time * options_.time_scale_;  // curvature unit: ms
 
         if (!given_offset_time_) {
             int layer = pl_orig.points[i].ring;
             double yaw_angle = atan2(added_pt.y, added_pt.x) * 57.2957;
 
-            if (is_first[layer]) {
-                yaw_fp[layer] = yaw_angle;
-                is_first[layer] = false;
+            if (is_first_[layer]) {
+                yaw_fp_[layer] = yaw_angle;
+                is_first_[layer] = false;
                 added_pt.curvature = 0.0;
-                yaw_last[layer] = yaw_angle;
-                time_last[layer] = added_pt.curvature;
+                yaw_last_[layer] = yaw_angle;
+                time_last_[layer] = added_pt.curvature;
                 continue;
             }
 
             // compute offset time
-            if (yaw_angle <= yaw_fp[layer]) {
-                added_pt.curvature = (yaw_fp[layer] - yaw_angle) / omega_l;
+            if (yaw_angle <= yaw_fp_[layer]) {
+                added_pt.curvature = (yaw_fp_[layer] - yaw_angle) / omega_l;
             } else {
-                added_pt.curvature = (yaw_fp[layer] - yaw_angle + 360.0) / omega_l;
+                added_pt.curvature = (yaw_fp_[layer] - yaw_angle + 360.0) / omega_l;
             }
 
-            if (added_pt.curvature < time_last[layer]) added_pt.curvature += 360.0 / omega_l;
+            if (added_pt.curvature < time_last_[layer]) added_pt.curvature += 360.0 / omega_l;
 
-            yaw_last[layer] = yaw_angle;
-            time_last[layer] = added_pt.curvature;
+            yaw_last_[layer] = yaw_angle;
+            time_last_[layer] = added_pt.curvature;
         }
 
-        if (i % point_filter_num_ == 0) {
-            if (added_pt.x * added_pt.x + added_pt.y * added_pt.y + added_pt.z * added_pt.z > (blind_ * blind_)) {
+        if (i % options_.point_filter_num_ == 0) {
+            if (added_pt.x * added_pt.x + added_pt.y * added_pt.y + added_pt.z * added_pt.z >
+                (options_.blind_ * options_.blind_)) {
                 cloud_out_.points.push_back(added_pt);
             }
         }
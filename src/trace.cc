@@ -0,0 +1,114 @@
+#include "trace.h"
+
+#include <glog/logging.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+namespace faster_lio {
+
+namespace {
+/// kernel id of the calling thread, the same as in top or perf
+uint32_t ThreadId() {
+    thread_local const uint32_t tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void WriteJsonString(std::ostream &os, const std::string &s) {
+    os << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+}  // namespace
+
+void Tracer::Reset(size_t capacity) {
+    capacity_ = capacity;
+    events_.reset(capacity_ > 0 ? new Event[capacity_] : nullptr);
+    next_ = 0;
+}
+
+void Tracer::Record(const char *name, int64_t begin_ns, int64_t end_ns) {
+    if (capacity_ == 0) {
+        return;
+    }
+
+    const uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    Event &e = events_[index % capacity_];
+    e.seq_.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    while (*name == ' ') {
+        ++name;  // the timer indents the nested stages
+    }
+    std::strncpy(e.name_, name, kMaxNameLength);
+    e.name_[kMaxNameLength] = '\0';
+    e.tid_ = ThreadId();
+    e.begin_ns_ = begin_ns;
+    e.end_ns_ = end_ns;
+    e.seq_.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::SetThreadName(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_names_);
+    thread_names_[ThreadId()] = name;
+}
+
+bool Tracer::Dump(const std::string &file_name) const {
+    std::ofstream ofs(file_name);
+    if (!ofs.is_open()) {
+        LOG(ERROR) << "Failed to open file: " << file_name;
+        return false;
+    }
+
+    const int pid = getpid();
+    ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(mtx_names_);
+        for (const auto &t : thread_names_) {
+            ofs << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << t.first << ",\"args\":{\"name\":";
+            WriteJsonString(ofs, t.second);
+            ofs << "}}";
+            first = false;
+        }
+    }
+
+    size_t num_events = 0;
+    const uint64_t end = next_.load(std::memory_order_acquire);
+    for (uint64_t i = end > capacity_ ? end - capacity_ : 0; i < end; ++i) {
+        // copy the slot, then check that no writer touched it meanwhile
+        const Event &e = events_[i % capacity_];
+        if (e.seq_.load(std::memory_order_acquire) != i + 1) {
+            continue;
+        }
+        const std::string name(e.name_);
+        const uint32_t tid = e.tid_;
+        const int64_t begin_ns = e.begin_ns_, end_ns = e.end_ns_;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.seq_.load(std::memory_order_relaxed) != i + 1) {
+            continue;
+        }
+
+        ofs << (first ? "" : ",\n") << "{\"name\":";
+        WriteJsonString(ofs, name);
+        ofs << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"ts\":" << begin_ns * 1e-3
+            << ",\"dur\":" << (end_ns - begin_ns) * 1e-3 << "}";
+        first = false;
+        num_events++;
+    }
+    ofs << "\n]}\n";
+    ofs.close();
+
+    LOG(INFO) << "Dump " << num_events << " trace events into file: " << file_name;
+    return !ofs.fail();
+}
+
+}  // namespace faster_lio
@@ -1,11 +0,0 @@
-//
-// Created by xiang on 2021/10/11.
-//
-
-#include "utils.h"
-
-namespace faster_lio {
-
-std::map<std::string, Timer::TimerRecord> Timer::records_;
-
-}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "cloud_pool.h"
+
+namespace faster_lio {
+
+/// a dropped cloud comes back from Acquire, cleared but with its capacity
+TEST(CloudPool, ReusesReleasedClouds) {
+    CloudPool pool(2);
+    CloudPtr cloud = pool.Acquire();
+    cloud->points.resize(100);
+    PointCloudType *raw = cloud.get();
+    const size_t capacity = cloud->points.capacity();
+    cloud.reset();
+    EXPECT_EQ(pool.Bytes(), capacity * sizeof(PointType));
+
+    cloud = pool.Acquire();
+    EXPECT_EQ(cloud.get(), raw);
+    EXPECT_TRUE(cloud->empty());
+    EXPECT_EQ(cloud->points.capacity(), capacity);
+}
+
+/// a cloud still held is never handed out twice, the clouds beyond max_clouds are not kept
+TEST(CloudPool, HeldCloudsAreNotShared) {
+    CloudPool pool(1);
+    CloudPtr first = pool.Acquire();
+    CloudPtr second = pool.Acquire();
+    EXPECT_NE(first.get(), second.get());
+
+    second->points.resize(100);
+    second.reset();
+    EXPECT_EQ(pool.Bytes(), 0u);
+    EXPECT_NE(pool.Acquire().get(), first.get());
+}
+
+/// the clouds may outlive the pool
+TEST(CloudPool, CloudOutlivesPool) {
+    CloudPtr cloud;
+    {
+        CloudPool pool;
+        cloud = pool.Acquire();
+        pool.Acquire();
+    }
+    cloud->points.resize(10);
+    cloud.reset();
+}
+
+/// clouds dropped on other threads go back to the pool
+TEST(CloudPool, ConcurrentAcquireAndRelease) {
+    CloudPool pool(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool]() {
+            for (int i = 0; i < 1000; ++i) {
+                CloudPtr cloud = pool.Acquire();
+                ASSERT_TRUE(cloud->empty());
+                cloud->points.resize(i % 50 + 1);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    std::vector<CloudPtr> clouds;
+    for (int i = 0; i < 4; ++i) {
+        clouds.emplace_back(pool.Acquire());
+        EXPECT_TRUE(clouds.back()->empty());
+    }
+}
+
+}  // namespace faster_lio
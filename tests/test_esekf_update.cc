@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "use-ikfom.hpp"
+
+namespace faster_lio {
+namespace {
+
+using KFType = esekfom::esekf<state_ikfom, 12, input_ikfom>;
+using Jacobian = Eigen::Matrix<double, 12, Eigen::Dynamic>;
+
+KFType MakeFilter() {
+    KFType kf;
+    std::vector<double> epsi(23, 0.001);
+    kf.init_dyn_runtime_share(get_f, df_dx, df_dw, 4, epsi.data());
+
+    srand(11);
+    const Eigen::Matrix<double, 23, 23> L = Eigen::Matrix<double, 23, 23>::Random() * 0.1;
+    KFType::cov P = L * L.transpose() + Eigen::Matrix<double, 23, 23>::Identity() * 1e-3;
+    kf.change_P(P);
+    return kf;
+}
+
+/// a fixed linear observation, every call of the model gives the same measurements
+struct Observation {
+    explicit Observation(int num) {
+        srand(num);
+        h_x_T = Jacobian::Random(12, num);
+        h = Eigen::VectorXd::Random(num) * 0.01;
+        weight = (Eigen::VectorXd::Random(num).array() * 0.4 + 0.6).matrix();
+    }
+
+    Jacobian h_x_T;
+    Eigen::VectorXd h;
+    Eigen::VectorXd weight;
+};
+
+void ExpectFilterNear(KFType &a, KFType &b, double tol) {
+    const state_ikfom xa = a.get_x(), xb = b.get_x();
+    EXPECT_LT((xa.pos - xb.pos).norm(), tol);
+    EXPECT_LT((xa.rot.toRotationMatrix() - xb.rot.toRotationMatrix()).norm(), tol);
+    EXPECT_LT((xa.offset_T_L_I - xb.offset_T_L_I).norm(), tol);
+    EXPECT_LT((a.get_P() - b.get_P()).norm(), tol);
+}
+
+}  // namespace
+
+/// the first dof columns of larger, reused buffers give the same update as buffers of the exact size
+TEST(EsekfUpdate, PersistentBuffersMatchExactSize) {
+    for (const int num : {10, 300}) {  // fewer and more measurements than states, both solver paths
+        const Observation obs(num);
+        KFType kf_exact = MakeFilter();
+        KFType kf_reused = MakeFilter();
+        double solve_time = 0;
+
+        kf_exact.update_iterated_dyn_share_modified(0.001, solve_time,
+                                                    [&](state_ikfom &, esekfom::dyn_share_datastruct<double> &data) {
+                                                        data.h_x_T = obs.h_x_T;
+                                                        data.h = obs.h;
+                                                        data.weight = obs.weight;
+                                                    });
+
+        esekfom::dyn_share_datastruct<double> data;
+        data.h_x_T = Jacobian::Constant(12, num + 100, 1e3);  // stale columns after the first dof
+        data.h = Eigen::VectorXd::Constant(num + 100, 1e3);
+        data.weight = Eigen::VectorXd::Constant(num + 100, 1e3);
+        kf_reused.update_iterated_dyn_share_modified(
+            0.001, solve_time,
+            [&](state_ikfom &, esekfom::dyn_share_datastruct<double> &d) {
+                d.h_x_T.leftCols(num) = obs.h_x_T;
+                d.h.head(num) = obs.h;
+                d.weight.head(num) = obs.weight;
+                d.dof = num;
+            },
+            data);
+
+        ExpectFilterNear(kf_exact, kf_reused, 1e-9);
+    }
+}
+
+/// the chunked H^T W H equals whitening the measurements by sqrt(W) and solving without weights
+TEST(EsekfUpdate, WeightsMatchWhitenedMeasurements) {
+    const int num = 1000;  // several chunks and a partial one
+    const Observation obs(num);
+    KFType kf_weighted = MakeFilter();
+    KFType kf_whitened = MakeFilter();
+    double solve_time = 0;
+
+    kf_weighted.update_iterated_dyn_share_modified(0.001, solve_time,
+                                                   [&](state_ikfom &, esekfom::dyn_share_datastruct<double> &data) {
+                                                       data.h_x_T = obs.h_x_T;
+                                                       data.h = obs.h;
+                                                       data.weight = obs.weight;
+                                                   });
+
+    const Eigen::VectorXd sqrt_w = obs.weight.cwiseSqrt();
+    kf_whitened.update_iterated_dyn_share_modified(0.001, solve_time,
+                                                   [&](state_ikfom &, esekfom::dyn_share_datastruct<double> &data) {
+                                                       data.h_x_T = obs.h_x_T * sqrt_w.asDiagonal();
+                                                       data.h = sqrt_w.cwiseProduct(obs.h);
+                                                   });
+
+    ExpectFilterNear(kf_weighted, kf_whitened, 1e-8);
+}
+
+}  // namespace faster_lio
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+
+#include <list>
+#include <map>
+#include <random>
+
+#include "ivox3d/ivox3d.h"
+
+namespace faster_lio {
+namespace {
+
+using IVoxType = IVox<3, IVoxNodeType::DEFAULT, pcl::PointXYZ>;
+
+IVoxType::Options MakeOptions(bool keep_distribution) {
+    IVoxType::Options options;
+    options.resolution_ = 1.0;
+    options.capacity_ = 1000;
+    options.keep_distribution_ = keep_distribution;
+    return options;
+}
+
+/// points around the center of grid (0, 0, 0)
+IVoxType::PointVector MakeGridPoints() {
+    IVoxType::PointVector points;
+    for (int i = 0; i < 10; ++i) {
+        points.emplace_back(0.04f * i - 0.2f, 0.02f * i - 0.1f, 0.03f * (i % 3) - 0.03f);
+    }
+    return points;
+}
+
+/// the grids an IVox should hold, kept with plain lookups and the same lru policy, for brute force queries
+class ReferenceGrids {
+   public:
+    ReferenceGrids(float resolution, std::size_t capacity) : inv_resolution_(1.0 / resolution), capacity_(capacity) {}
+
+    void AddPoint(const pcl::PointXYZ& pt) {
+        const Key key = Pos2Grid(pt);
+        auto iter = grids_.find(key);
+        if (iter == grids_.end()) {
+            lru_.emplace_front(key);
+            grids_[key] = {lru_.begin(), {pt}};
+            if (grids_.size() >= capacity_) {
+                grids_.erase(lru_.back());
+                lru_.pop_back();
+            }
+        } else {
+            iter->second.points_.emplace_back(pt);
+            lru_.splice(lru_.begin(), lru_, iter->second.lru_iter_);
+        }
+    }
+
+    /// sorted squared distances of the max_num closest points in the nearby range
+    std::vector<double> Knn(const pcl::PointXYZ& pt, int nearby_num, int max_num, double max_range) const {
+        const Key key = Pos2Grid(pt);
+        std::vector<double> dists;
+        for (int i = 0; i < nearby_num; ++i) {
+            const Key nearby{key[0] + NEARBY_OFFSETS[i][0], key[1] + NEARBY_OFFSETS[i][1],
+                             key[2] + NEARBY_OFFSETS[i][2]};
+            auto iter = grids_.find(nearby);
+            if (iter == grids_.end()) {
+                continue;
+            }
+            for (const auto& p : iter->second.points_) {
+                const double d = distance2(p, pt);
+                if (d < max_range * max_range) {
+                    dists.emplace_back(d);
+                }
+            }
+        }
+        std::sort(dists.begin(), dists.end());
+        dists.resize(std::min<std::size_t>(dists.size(), max_num));
+        return dists;
+    }
+
+    bool HasGrid(const pcl::PointXYZ& pt) const { return grids_.count(Pos2Grid(pt)) > 0; }
+
+   private:
+    using Key = std::array<int, 3>;
+
+    struct Grid {
+        std::list<Key>::iterator lru_iter_;
+        std::vector<pcl::PointXYZ> points_;
+    };
+
+    Key Pos2Grid(const pcl::PointXYZ& pt) const {
+        const Eigen::Vector3i key = (pt.getVector3fMap() * inv_resolution_).array().round().cast<int>();
+        return {key[0], key[1], key[2]};
+    }
+
+    float inv_resolution_;
+    std::size_t capacity_;
+    std::list<Key> lru_;
+    std::map<Key, Grid> grids_;
+};
+
+}  // namespace
+
+/// the distributions are not kept by default, GetDistribution reports that instead of a zero covariance
+TEST(IVox, NoDistributionByDefault) {
+    IVoxType ivox(MakeOptions(false));
+    ivox.AddPoints(MakeGridPoints());
+
+    Eigen::Vector3f mean;
+    Eigen::Matrix3f cov;
+    EXPECT_FALSE(ivox.GetDistribution(pcl::PointXYZ(0.0f, 0.0f, 0.0f), mean, cov, 2));
+}
+
+/// the kept distribution matches the batch mean and sample covariance of the inserted points
+TEST(IVox, DistributionMatchesBatch) {
+    const auto points = MakeGridPoints();
+    IVoxType ivox(MakeOptions(true));
+    ivox.AddPoints(points);
+
+    Eigen::Vector3f batch_mean = Eigen::Vector3f::Zero();
+    for (const auto& pt : points) {
+        batch_mean += pt.getVector3fMap();
+    }
+    batch_mean /= points.size();
+    Eigen::Matrix3f batch_cov = Eigen::Matrix3f::Zero();
+    for (const auto& pt : points) {
+        const Eigen::Vector3f d = pt.getVector3fMap() - batch_mean;
+        batch_cov += d * d.transpose();
+    }
+    batch_cov /= points.size() - 1;
+
+    Eigen::Vector3f mean;
+    Eigen::Matrix3f cov;
+    ASSERT_TRUE(ivox.GetDistribution(pcl::PointXYZ(0.0f, 0.0f, 0.0f), mean, cov, 2));
+    EXPECT_TRUE(mean.isApprox(batch_mean, 1e-5));
+    EXPECT_TRUE(cov.isApprox(batch_cov, 1e-4));
+    EXPECT_FALSE(ivox.GetDistribution(pcl::PointXYZ(0.0f, 0.0f, 0.0f), mean, cov, points.size() + 1));
+}
+
+/// the hash map is only sized up front for expected_grids_, not for the capacity
+TEST(IVox, ReservesExpectedGrids) {
+    IVoxType::Options options = MakeOptions(false);
+    options.capacity_ = 1000000;
+    EXPECT_LT(IVoxType(options).VoxelBytes(), 1024u);
+
+    options.expected_grids_ = 10000;
+    EXPECT_GE(IVoxType(options).VoxelBytes(), options.expected_grids_ * sizeof(void*));
+}
+
+/// the quantized kernel finds the same points as a scan of the decoded ones, also in a partly filled last block
+TEST(IVoxNodeQuantized, KNNMatchesDecodedPoints) {
+    using NodeType = IVoxNodeQuantized<pcl::PointXYZ, 3>;
+    for (int num = 1; num <= 9; ++num) {
+        NodeType node(pcl::PointXYZ(0.0f, 0.0f, 0.0f), 1.0f);
+        for (int i = 0; i < num; ++i) {
+            node.InsertPoint(pcl::PointXYZ(0.1f * i - 0.4f, 0.05f * i - 0.2f, 0.02f * i));
+        }
+
+        const pcl::PointXYZ query(0.05f, 0.0f, 0.1f);
+        const double max_range = 0.3;
+        std::vector<NodeType::DistPoint> dist_points;
+        node.KNNPointByCondition(dist_points, query, num, max_range);
+
+        std::size_t expected = 0;
+        for (int i = 0; i < num; ++i) {
+            expected += distance2(node.GetPoint(i), query) < max_range * max_range;
+        }
+        ASSERT_EQ(dist_points.size(), expected) << num << " points";
+        for (auto& dist_point : dist_points) {
+            EXPECT_LT(dist_point.idx, num);
+            EXPECT_NEAR(dist_point.dist, distance2(dist_point.Get(), query), 1e-6);
+        }
+    }
+}
+
+/// the nearby links give the same neighbours as looking the grids up, across evictions and nearby range changes
+TEST(IVox, LinkedKnnMatchesBruteForce) {
+    IVoxType::Options options;
+    options.resolution_ = 0.5;
+    options.capacity_ = 300;  // far fewer than the grids of the points, so the lru evicts all the time
+    options.nearby_type_ = IVoxType::NearbyType::NEARBY18;
+    IVoxType ivox(options);
+    ReferenceGrids reference(options.resolution_, options.capacity_);
+
+    const std::vector<std::pair<IVoxType::NearbyType, int>> nearby_types = {
+        {IVoxType::NearbyType::NEARBY18, 19},
+        {IVoxType::NearbyType::CENTER, 1},
+        {IVoxType::NearbyType::NEARBY26, 27},
+        {IVoxType::NearbyType::NEARBY6, 7}};
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> uniform(-4.0f, 4.0f);
+    const auto random_point = [&]() { return pcl::PointXYZ(uniform(rng), uniform(rng), 0.25f * uniform(rng)); };
+
+    int num_missing_center = 0;
+    for (int round = 0; round < 8; ++round) {
+        const auto& nearby = nearby_types[round % nearby_types.size()];
+        ivox.SetNearbyType(nearby.first);
+
+        for (int i = 0; i < 2000; ++i) {
+            const pcl::PointXYZ pt = random_point();
+            ivox.AddPoint(pt);
+            reference.AddPoint(pt);
+        }
+
+        for (int i = 0; i < 500; ++i) {
+            const pcl::PointXYZ query = random_point();
+            IVoxType::PointVector closest;
+            ivox.GetClosestPoint(query, closest, 5, 1.0);
+
+            std::vector<double> dists;
+            for (const auto& pt : closest) {
+                dists.emplace_back(distance2(pt, query));
+            }
+            std::sort(dists.begin(), dists.end());
+
+            const std::vector<double> expected = reference.Knn(query, nearby.second, 5, 1.0);
+            ASSERT_EQ(dists.size(), expected.size()) << "round " << round << ", query " << i;
+            for (std::size_t k = 0; k < dists.size(); ++k) {
+                EXPECT_NEAR(dists[k], expected[k], 1e-9);
+            }
+            num_missing_center += !reference.HasGrid(query) && !expected.empty();
+        }
+    }
+    EXPECT_GT(num_missing_center, 0);  // queries next to the map, not in one of its grids, were covered
+}
+
+}  // namespace faster_lio
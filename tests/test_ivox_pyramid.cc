@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include "ivox3d/ivox3d_pyramid.h"
+
+namespace faster_lio {
+namespace {
+
+using PyramidType = IVoxPyramid<3, IVoxNodeType::DEFAULT, pcl::PointXYZ>;
+
+PyramidType MakePyramid(int num_coarse) {
+    PyramidType::IVoxType::Options options;
+    options.resolution_ = 0.5;
+    options.capacity_ = 1000;
+    std::vector<float> coarse;
+    for (int i = 0; i < num_coarse; ++i) {
+        coarse.emplace_back(1.0f * (i + 1));
+    }
+    return PyramidType(options, coarse, 20);
+}
+
+}  // namespace
+
+/// the last observation of the IEKF, which gives the posterior, always matches against the finest level
+TEST(IVoxPyramid, LastIterationUsesFinestLevel) {
+    for (int num_coarse = 0; num_coarse <= 5; ++num_coarse) {
+        const PyramidType pyramid = MakePyramid(num_coarse);
+        ASSERT_EQ(pyramid.NumLevels(), num_coarse + 1);
+        for (int max_iter = 1; max_iter <= 6; ++max_iter) {
+            EXPECT_EQ(pyramid.LevelAtIteration(max_iter, max_iter), 0)
+                << num_coarse << " coarse levels, max_iter " << max_iter;
+            for (int iter = 1; iter <= max_iter; ++iter) {
+                EXPECT_LE(pyramid.LevelAtIteration(iter, max_iter), pyramid.LevelAtIteration(iter - 1, max_iter));
+            }
+        }
+    }
+}
+
+/// with fewer levels than iterations the schedule is coarsest first, one level finer per iteration
+TEST(IVoxPyramid, CoarseToFineSchedule) {
+    const PyramidType pyramid = MakePyramid(2);
+    EXPECT_EQ(pyramid.LevelAtIteration(0, 4), 2);
+    EXPECT_EQ(pyramid.LevelAtIteration(1, 4), 1);
+    EXPECT_EQ(pyramid.LevelAtIteration(2, 4), 0);
+    EXPECT_EQ(pyramid.LevelAtIteration(4, 4), 0);
+}
+
+}  // namespace faster_lio
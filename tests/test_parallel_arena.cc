@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "parallel_arena.h"
+
+namespace faster_lio {
+
+#ifdef __linux__
+/// the calling thread is pinned only while it runs a loop, its own mask is back afterwards
+TEST(ParallelArena, PinningIsRestoredAfterLoops) {
+    cpu_set_t before;
+    ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &before), 0);
+    int first_cpu = 0;
+    while (!CPU_ISSET(first_cpu, &before)) {
+        ++first_cpu;
+    }
+
+    ParallelArena::Options options;
+    options.num_threads_ = 2;
+    options.cpu_ids_ = {first_cpu};
+    ParallelArena arena(options);
+
+    tbb::affinity_partitioner partitioner;
+    std::atomic<long> sum{0};
+    for (int k = 0; k < 10; ++k) {
+        arena.ParallelFor(0, 10000, partitioner, [&](const tbb::blocked_range<int> &r) {
+            for (int i = r.begin(); i < r.end(); ++i) {
+                sum += i;
+            }
+        });
+    }
+    EXPECT_EQ(sum.load(), 10L * 10000 * 9999 / 2);
+
+    cpu_set_t after;
+    ASSERT_EQ(pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &after), 0);
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+}
+#endif
+
+}  // namespace faster_lio